@@ -58,6 +58,8 @@ private:
 	MP2Node **mp2;
 	Params *par;
 	map<string, string> testKVPairs;
+	// consistency level of every request the tests send
+	ConsistencyLevel consistency;
 public:
 	Application(char *);
 	virtual ~Application();
@@ -69,9 +71,15 @@ public:
 	void fail();
 	void insertTestKVPairs();
 	int findARandomNodeThatIsAlive();
+	Completion logCompletion(int number);
 	void deleteTest();
 	void readTest();
 	void updateTest();
+	void reportRingLoad();
+	void reportLatency();
+	void reportRebalance();
+	void reportMembership();
+	void drainQueues();
 };
 
 #endif /* _APPLICATION_H__ */
@@ -0,0 +1,496 @@
+/**********************************
+ * FILE NAME: Benchmark.cpp
+ *
+ * DESCRIPTION: Microbenchmarks for the building blocks of the KV store.
+ * 				Build with "make Benchmark" and run "./Benchmark [name]".
+ **********************************/
+
+#include "stdincludes.h"
+#include "Message.h"
+#include "FlatHashMap.h"
+#include "RingIndex.h"
+#include "Partitioner.h"
+#include "TimerWheel.h"
+#include "MembershipTable.h"
+#include <chrono>
+#include <random>
+
+/*
+ * Macros
+ */
+#define MESSAGE_ITERATIONS 1000000
+#define PARTITIONER_KEYS 1000000
+#define TIMER_TICKS 1000
+#define TIMER_TIMEOUT 40
+// entries merged per size, spread over as many gossip messages as it takes
+#define GOSSIP_ENTRIES 1000000
+// ticks a member may stay silent and still take a newer heartbeat, TFAIL of MP1Node
+#define TFAIL_WINDOW 10
+
+/**
+ * FUNCTION NAME: nowNs
+ *
+ * DESCRIPTION: Monotonic clock in nanoseconds
+ */
+static double nowNs() {
+	return (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * FUNCTION NAME: benchMessageType
+ *
+ * DESCRIPTION: Time encode and decode of one message in both wire formats. Each
+ * 				format is decoded both into a Message, which copies key and value,
+ * 				and into a MessageView, which does not.
+ */
+static void benchMessageType(const char *name, Message msg) {
+	volatile size_t sink = 0;
+	string text = msg.toString();
+	string binary = msg.toBinary();
+	double t0, encText, encBinary, decText, decBinary, viewText, viewBinary;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		sink += msg.toString().size();
+	}
+	encText = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		sink += msg.toBinary().size();
+	}
+	encBinary = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		Message decoded(text.data(), (int)text.size());
+		sink += decoded.key.size();
+	}
+	decText = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		Message decoded(binary.data(), (int)binary.size());
+		sink += decoded.key.size();
+	}
+	decBinary = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		MessageView view;
+		Message::decode(text.data(), (int)text.size(), view);
+		sink += view.key.size();
+	}
+	viewText = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	t0 = nowNs();
+	for ( int i = 0; i < MESSAGE_ITERATIONS; i++ ) {
+		MessageView view;
+		Message::decode(binary.data(), (int)binary.size(), view);
+		sink += view.key.size();
+	}
+	viewBinary = (nowNs() - t0) / MESSAGE_ITERATIONS;
+
+	printf("%-10s text: %4zu B  enc %7.1f ns  dec %7.1f ns  dec(view) %7.1f ns | binary: %4zu B  enc %7.1f ns  dec %7.1f ns  dec(view) %7.1f ns\n",
+			name, text.size(), encText, decText, viewText, binary.size(), encBinary, decBinary, viewBinary);
+}
+
+/**
+ * FUNCTION NAME: benchMessage
+ *
+ * DESCRIPTION: Wire codec benchmark, ns/op and bytes on the wire for every MessageType
+ */
+static void benchMessage() {
+	Address addr(string("17:0"));
+	string key = "k7Qz2";
+	string value = "value" + string(32, 'x');
+
+	printf("== message codec (%d iterations)\n", MESSAGE_ITERATIONS);
+	benchMessageType("CREATE", Message(12345, addr, CREATE, key, value, PRIMARY));
+	benchMessageType("READ", Message(12345, addr, READ, key));
+	benchMessageType("UPDATE", Message(12345, addr, UPDATE, key, value, SECONDARY));
+	benchMessageType("DELETE", Message(12345, addr, DELETE, key));
+	benchMessageType("REPLY", Message(12345, addr, REPLY, true));
+	benchMessageType("READREPLY", Message(12345, addr, value));
+
+	// 25 keys batched for one replica
+	vector<BatchEntry> entries;
+	for ( int i = 0; i < 25; i++ ) {
+		entries.push_back({key + to_string(i), value, i % 3});
+	}
+	benchMessageType("MULTIPUT", Message(12345, addr, MULTIPUT, entries));
+
+	// Merkle leaves of one token range
+	vector<unsigned long long> digest;
+	for ( int i = 0; i < 64; i++ ) {
+		digest.push_back(Partitioner::xxh64((const char *)&i, sizeof(i), 0));
+	}
+	benchMessageType("DIGEST", Message(addr, 1ULL << 40, 1ULL << 63, digest));
+}
+
+/**
+ * FUNCTION NAME: benchEngine
+ *
+ * DESCRIPTION: Time create, read, update and delete of every key against one
+ * 				storage engine, the same way HashTable drives it
+ */
+template <class Engine>
+static void benchEngine(const char *name, const vector<string> &keys, const vector<string> &lookupOrder) {
+	Engine table;
+	size_t n = keys.size();
+	volatile size_t sink = 0;
+	double t0, create, read, update, erase;
+
+	t0 = nowNs();
+	for ( size_t i = 0; i < n; i++ ) {
+		table.emplace(keys[i], "value" + to_string(i % 100));
+	}
+	create = (nowNs() - t0) / n;
+
+	t0 = nowNs();
+	for ( size_t i = 0; i < n; i++ ) {
+		typename Engine::iterator it = table.find(lookupOrder[i]);
+		if ( it != table.end() ) {
+			sink += it->second.size();
+		}
+	}
+	read = (nowNs() - t0) / n;
+
+	t0 = nowNs();
+	for ( size_t i = 0; i < n; i++ ) {
+		typename Engine::iterator it = table.find(lookupOrder[i]);
+		if ( it != table.end() ) {
+			it->second = "newValue";
+		}
+	}
+	update = (nowNs() - t0) / n;
+
+	t0 = nowNs();
+	for ( size_t i = 0; i < n; i++ ) {
+		sink += table.erase(lookupOrder[i]);
+	}
+	erase = (nowNs() - t0) / n;
+
+	printf("%-12s %9zu keys  create %7.1f ns  read %7.1f ns  update %7.1f ns  delete %7.1f ns\n",
+			name, n, create, read, update, erase);
+}
+
+/**
+ * FUNCTION NAME: benchHashTable
+ *
+ * DESCRIPTION: Flat open addressing engine against the old std::map engine
+ */
+static void benchHashTable(const vector<size_t> &sizes) {
+	mt19937_64 rng(42);
+
+	printf("== hash table engines\n");
+	for ( size_t n : sizes ) {
+		vector<string> keys;
+		keys.reserve(n);
+		for ( size_t i = 0; i < n; i++ ) {
+			keys.push_back("key" + to_string(rng()));
+		}
+		vector<string> lookupOrder(keys);
+		shuffle(lookupOrder.begin(), lookupOrder.end(), rng);
+
+		benchEngine<FlatHashMap<string>>("FlatHashMap", keys, lookupOrder);
+		benchEngine<map<string, string>>("std::map", keys, lookupOrder);
+	}
+}
+
+/**
+ * FUNCTION NAME: benchPartitionerMode
+ *
+ * DESCRIPTION: Key hashing throughput of the current partitioner mode, and how
+ * 				evenly it spreads keys over the primaries of rings of several sizes
+ */
+static void benchPartitionerMode(const vector<string> &keys) {
+	volatile size_t sink = 0;
+	double t0 = nowNs();
+	for ( const string &key : keys ) {
+		sink += Partitioner::keyPosition(key);
+	}
+	double hashNs = (nowNs() - t0) / keys.size();
+	printf("%-7s key hash %5.1f ns\n", Partitioner::name(), hashNs);
+
+	for ( int n : {10, 100, 1000} ) {
+		for ( int vnodes : {1, 8} ) {
+			vector<Node> nodes;
+			for ( int id = 1; id <= n; id++ ) {
+				Address addr(to_string(id) + ":0");
+				for ( int v = 0; v < vnodes; v++ ) {
+					nodes.emplace_back(Node(addr, v));
+				}
+			}
+			sort(nodes.begin(), nodes.end());
+			size_t collisions = 0;
+			for ( size_t i = 1; i < nodes.size(); i++ ) {
+				collisions += (nodes[i].getHashCode() == nodes[i - 1].getHashCode());
+			}
+			RingIndex ring;
+			ring.build(nodes, 1);
+
+			map<unsigned long long, double> keysPerNode;
+			for ( int id = 1; id <= n; id++ ) {
+				keysPerNode[Address(to_string(id) + ":0").pack()] = 0;
+			}
+			for ( const string &key : keys ) {
+				keysPerNode[ring.findNodes(Partitioner::keyPosition(key))[0].nodeAddress.pack()]++;
+			}
+			double mean = (double)keys.size() / n;
+			double variance = 0, maxKeys = 0;
+			for ( auto &entry : keysPerNode ) {
+				variance += (entry.second - mean) * (entry.second - mean) / n;
+				maxKeys = max(maxKeys, entry.second);
+			}
+			printf("%-7s %5d nodes x %d vnodes  token collisions %4zu  keys/node cv %.3f  max/mean %.2f\n",
+					Partitioner::name(), n, vnodes, collisions, sqrt(variance) / mean, maxKeys / mean);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: benchPartitioner
+ *
+ * DESCRIPTION: Compatibility 512 position ring against the 64-bit ring
+ */
+static void benchPartitioner() {
+	mt19937_64 rng(42);
+	vector<string> keys;
+	for ( int i = 0; i < PARTITIONER_KEYS; i++ ) {
+		keys.push_back("key" + to_string(rng()));
+	}
+
+	printf("== partitioner (%d keys, cv = stddev / mean of primary keys per node)\n", PARTITIONER_KEYS);
+	Partitioner::mode = PARTITIONER_COMPAT;
+	benchPartitionerMode(keys);
+	Partitioner::mode = PARTITIONER_HASH64;
+	benchPartitionerMode(keys);
+}
+
+/**
+ * FUNCTION NAME: simulateTimeouts
+ *
+ * DESCRIPTION: Steady state coordinator with about n transactions in flight: every
+ * 				tick n / TIMER_TIMEOUT start, those that started TIMER_TIMEOUT ticks ago
+ * 				finish, except one in a hundred which times out instead. Returns the
+ * 				ns per tick spent expiring, by full scan or by the timing wheel.
+ */
+static double simulateTimeouts(size_t n, bool useWheel, size_t &expired) {
+	unordered_map<int, int> started;
+	TimerWheel wheel;
+	vector<int> due;
+	int perTick = max(1, (int)(n / TIMER_TIMEOUT));
+	double spent = 0;
+	expired = 0;
+
+	for ( int now = 0; now < TIMERWHEEL_SLOTS + TIMER_TICKS; now++ ) {
+		for ( int i = 0; i < perTick; i++ ) {
+			int id = now * perTick + i;
+			started[id] = now;
+			wheel.schedule(id, now + TIMER_TIMEOUT + 1);
+		}
+		if ( now >= TIMER_TIMEOUT ) {
+			for ( int i = 0; i < perTick; i++ ) {
+				int id = (now - TIMER_TIMEOUT) * perTick + i;
+				if ( id % 100 != 0 ) {
+					started.erase(id);
+				}
+			}
+		}
+
+		double t0 = nowNs();
+		if ( useWheel ) {
+			due.clear();
+			wheel.advance(now, due);
+			for ( int id : due ) {
+				expired += started.erase(id);
+			}
+		}
+		else {
+			due.clear();
+			for ( auto &entry : started ) {
+				if ( entry.second + TIMER_TIMEOUT < now ) {
+					due.push_back(entry.first);
+				}
+			}
+			for ( int id : due ) {
+				expired += started.erase(id);
+			}
+		}
+		if ( now >= TIMERWHEEL_SLOTS ) {
+			spent += nowNs() - t0;
+		}
+	}
+	return spent / TIMER_TICKS;
+}
+
+/**
+ * FUNCTION NAME: benchTimers
+ *
+ * DESCRIPTION: Per tick cost of expiring transactions, scanning the whole table
+ * 				against the timing wheel
+ */
+static void benchTimers(const vector<size_t> &sizes) {
+	printf("== transaction timeouts (%d ticks, timeout %d)\n", TIMER_TICKS, TIMER_TIMEOUT);
+	for ( size_t n : sizes ) {
+		size_t expiredScan, expiredWheel;
+		double scan = simulateTimeouts(n, false, expiredScan);
+		double wheel = simulateTimeouts(n, true, expiredWheel);
+		printf("%9zu in flight  scan %10.1f ns/tick  wheel %8.1f ns/tick  expired %zu/%zu\n",
+				n, scan, wheel, expiredScan, expiredWheel);
+	}
+}
+
+/**
+ * FUNCTION NAME: mergeByScan
+ *
+ * DESCRIPTION: The gossip merge before the membership index: every received entry
+ * 				is looked up by a scan of the local list
+ */
+static void mergeByScan(vector<MemberListEntry> &list, const vector<MemberListEntry> &gossip, long now, long window) {
+	for ( const MemberListEntry &e : gossip ) {
+		bool isExist = false;
+		for ( size_t j = 0; j < list.size(); j++ ) {
+			if ( e.id == list[j].id && e.port == list[j].port ) {
+				isExist = true;
+				if ( e.heartbeat > list[j].heartbeat && list[j].timestamp + window >= now ) {
+					list[j].heartbeat = e.heartbeat;
+					list[j].timestamp = now;
+				}
+				break;
+			}
+		}
+		if ( !isExist ) {
+			list.push_back(e);
+			list.back().timestamp = now;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: benchMembership
+ *
+ * DESCRIPTION: Time to merge a full gossip message into a membership list of n
+ * 				members, all known and with newer heartbeats, scanning the list
+ * 				against the MembershipTable index
+ */
+static void benchMembership(const vector<size_t> &sizes) {
+	mt19937_64 rng(42);
+
+	printf("== gossip merge (%d entries per size)\n", GOSSIP_ENTRIES);
+	for ( size_t n : sizes ) {
+		vector<MemberListEntry> members;
+		for ( size_t i = 0; i < n; i++ ) {
+			members.push_back(MemberListEntry((int)i + 1, 0, 0, 0));
+		}
+		vector<MemberListEntry> gossip(members);
+		shuffle(gossip.begin(), gossip.end(), rng);
+		int rounds = max(1, (int)(GOSSIP_ENTRIES / n));
+
+		vector<MemberListEntry> scanned(members);
+		double t0 = nowNs();
+		for ( int r = 1; r <= rounds; r++ ) {
+			for ( MemberListEntry &e : gossip ) {
+				e.heartbeat = r;
+			}
+			mergeByScan(scanned, gossip, r, TFAIL_WINDOW);
+		}
+		double scan = (nowNs() - t0) / rounds;
+
+		vector<MemberListEntry> indexed(members);
+		MembershipTable table;
+		table.attach(&indexed);
+		t0 = nowNs();
+		for ( int r = 1; r <= rounds; r++ ) {
+			for ( MemberListEntry &e : gossip ) {
+				e.heartbeat = r;
+			}
+			for ( const MemberListEntry &e : gossip ) {
+				table.merge(e, r, TFAIL_WINDOW);
+			}
+		}
+		double index = (nowNs() - t0) / rounds;
+
+		printf("%6zu members  scan %12.1f ns/message  index %9.1f ns/message (%5.1f ns/entry)  %s\n",
+				n, scan, index, index / n, scanned.back().heartbeat == indexed.back().heartbeat ? "same" : "DIFFERENT");
+	}
+}
+
+/**
+ * FUNCTION NAME: benchMembershipWire
+ *
+ * DESCRIPTION: Size of a full gossip message of n members as raw MemberListEntry
+ * 				structs and packed, and time to pack it and to merge it into the
+ * 				index straight from the packed bytes
+ */
+static void benchMembershipWire(const vector<size_t> &sizes) {
+	mt19937_64 rng(42);
+
+	printf("== gossip wire format (%d entries per size)\n", GOSSIP_ENTRIES);
+	for ( size_t n : sizes ) {
+		// ids in join order, heartbeats a few ticks apart as joins are
+		vector<MemberListEntry> members;
+		for ( size_t i = 0; i < n; i++ ) {
+			members.push_back(MemberListEntry((int)i + 1, 0, 1000 + (long)(rng() % 20), 0));
+		}
+		int rounds = max(1, (int)(GOSSIP_ENTRIES / n));
+		vector<char> packed(MembershipTable::packedSize((int)n));
+		size_t bytes = 0;
+
+		double t0 = nowNs();
+		for ( int r = 1; r <= rounds; r++ ) {
+			members[r % n].heartbeat++;
+			bytes = MembershipTable::pack(members.data(), (int)n, packed.data()) - packed.data();
+		}
+		double pack = (nowNs() - t0) / rounds;
+
+		vector<MemberListEntry> indexed(members);
+		MembershipTable table;
+		table.attach(&indexed);
+		size_t merged = 0;
+		t0 = nowNs();
+		for ( int r = 1; r <= rounds; r++ ) {
+			MembershipTable::unpack(packed.data(), packed.data() + bytes, [&](const MemberListEntry &e) {
+				merged += table.merge(e, r, TFAIL_WINDOW) != MERGE_UNCHANGED;
+			});
+		}
+		double unpack = (nowNs() - t0) / rounds;
+
+		printf("%6zu members  raw %7zu B  packed %6zu B (%4.1f B/entry, %4.1fx)  pack %9.1f ns/message  unpack+merge %9.1f ns/message\n",
+				n, n * sizeof(MemberListEntry), bytes, (double)bytes / n, (double)(n * sizeof(MemberListEntry)) / bytes, pack, unpack);
+	}
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Run the benchmark named on the command line, or all of them
+ **********************************/
+int main(int argc, char *argv[]) {
+	string which = (argc > 1) ? argv[1] : "all";
+	// Optional sizes after the benchmark name, e.g. "./Benchmark hashtable 1000000"
+	vector<size_t> sizes;
+	for ( int i = 2; i < argc; i++ ) {
+		sizes.push_back(strtoul(argv[i], NULL, 10));
+	}
+
+	if ( which == "all" || which == "message" ) {
+		benchMessage();
+	}
+	if ( which == "all" || which == "hashtable" ) {
+		benchHashTable(sizes.empty() ? vector<size_t>{1000000, 10000000} : sizes);
+	}
+	if ( which == "all" || which == "partitioner" ) {
+		benchPartitioner();
+	}
+	if ( which == "all" || which == "timers" ) {
+		benchTimers(sizes.empty() ? vector<size_t>{1000, 10000, 100000} : sizes);
+	}
+	if ( which == "all" || which == "membership" ) {
+		benchMembership(sizes.empty() ? vector<size_t>{100, 1000, 10000} : sizes);
+		benchMembershipWire(sizes.empty() ? vector<size_t>{100, 1000, 10000} : sizes);
+	}
+
+	return SUCCESS;
+}
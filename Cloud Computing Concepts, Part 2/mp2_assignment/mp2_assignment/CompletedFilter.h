@@ -0,0 +1,76 @@
+/**********************************
+ * FILE NAME: CompletedFilter.h
+ *
+ * DESCRIPTION: Header file of the sliding bitmap of finished coordinator
+ * 				transactions
+ **********************************/
+
+#ifndef COMPLETEDFILTER_H_
+#define COMPLETEDFILTER_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// transIDs the window covers, a multiple of 64
+#define COMPLETEDFILTER_BITS 4096
+
+/**
+ * CLASS NAME: CompletedFilter
+ *
+ * DESCRIPTION: One bit per transID in the window [base, base + COMPLETEDFILTER_BITS),
+ * 				kept in a ring of words. transIDs only grow, so marking one past the
+ * 				window slides it forward and forgets the oldest. A transID outside
+ * 				the window is reported as not finished: the filter only answers
+ * 				"certainly finished", and the owner falls back to its own lookup.
+ */
+class CompletedFilter {
+	unsigned long long words[COMPLETEDFILTER_BITS / 64];
+	// first transID of the window, a multiple of 64
+	int base;
+
+	unsigned long long &word(int id) { return words[(id & (COMPLETEDFILTER_BITS - 1)) >> 6]; }
+
+public:
+	CompletedFilter(): base(0) { memset(words, 0, sizeof(words)); }
+
+	/**
+	 * FUNCTION NAME: insert
+	 *
+	 * DESCRIPTION: Mark id as finished
+	 */
+	void insert(int id) {
+		if ( id < base ) {
+			return;
+		}
+		if ( id >= base + COMPLETEDFILTER_BITS ) {
+			// smallest multiple of 64 whose window holds id
+			int next = ((id - COMPLETEDFILTER_BITS) / 64 + 1) * 64;
+			if ( next - base >= COMPLETEDFILTER_BITS ) {
+				memset(words, 0, sizeof(words));
+			}
+			else {
+				for ( int w = base; w < next; w += 64 ) {
+					word(w) = 0;
+				}
+			}
+			base = next;
+		}
+		word(id) |= 1ULL << (id & 63);
+	}
+
+	/**
+	 * FUNCTION NAME: contains
+	 *
+	 * DESCRIPTION: Whether id is known to be finished
+	 */
+	bool contains(int id) {
+		if ( id < base || id >= base + COMPLETEDFILTER_BITS ) {
+			return false;
+		}
+		return (word(id) >> (id & 63)) & 1;
+	}
+};
+
+#endif /* COMPLETEDFILTER_H_ */
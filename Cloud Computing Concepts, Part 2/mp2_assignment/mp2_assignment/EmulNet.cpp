@@ -23,6 +23,13 @@ EmulNet::EmulNet(Params *p)
 			recv_msgs[i][j] = 0;
 		}
 	}
+	for ( j = 0; j < MAX_TIME; j++ ) {
+		recv_calls[j] = 0;
+		recv_scanned[j] = 0;
+	}
+	pool_sends = 0;
+	pool_mallocs = 0;
+	pool_reuses = 0;
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
@@ -39,6 +46,13 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
 			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
 		}
 	}
+	for ( j = 0; j < MAX_TIME; j++ ) {
+		this->recv_calls[j] = anotherEmulNet.recv_calls[j];
+		this->recv_scanned[j] = anotherEmulNet.recv_scanned[j];
+	}
+	this->pool_sends = anotherEmulNet.pool_sends;
+	this->pool_mallocs = anotherEmulNet.pool_mallocs;
+	this->pool_reuses = anotherEmulNet.pool_reuses;
 	this->emulnet = anotherEmulNet.emulnet;
 }
 
@@ -55,6 +69,13 @@ EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
 			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
 		}
 	}
+	for ( j = 0; j < MAX_TIME; j++ ) {
+		this->recv_calls[j] = anotherEmulNet.recv_calls[j];
+		this->recv_scanned[j] = anotherEmulNet.recv_scanned[j];
+	}
+	this->pool_sends = anotherEmulNet.pool_sends;
+	this->pool_mallocs = anotherEmulNet.pool_mallocs;
+	this->pool_reuses = anotherEmulNet.pool_reuses;
 	this->emulnet = anotherEmulNet.emulnet;
 	return *this;
 }
@@ -76,10 +97,51 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
 	return myaddr;
 }
 
+/**
+ * FUNCTION NAME: ENallocmsg
+ *
+ * DESCRIPTION: Take a message buffer able to hold size bytes of payload from the pool.
+ * 				A fresh slab is malloc'd only when the free list of its class is empty.
+ */
+en_msg *EmulNet::ENallocmsg(int size) {
+	en_msg *em;
+	int sizeclass = 0;
+
+	while ( (EN_POOL_MIN_SLAB << sizeclass) < size ) {
+		sizeclass++;
+	}
+	assert(sizeclass < EN_POOL_CLASSES);
+
+	if ( !pool[sizeclass].empty() ) {
+		em = pool[sizeclass].back();
+		pool[sizeclass].pop_back();
+		pool_reuses++;
+	}
+	else {
+		em = (en_msg *)malloc(sizeof(en_msg) + (EN_POOL_MIN_SLAB << sizeclass));
+		pool_mallocs++;
+	}
+	em->sizeclass = sizeclass;
+	return em;
+}
+
+/**
+ * FUNCTION NAME: ENfree
+ *
+ * DESCRIPTION: Return a buffer handed out by ENrecv to the pool.
+ * 				The receiver owns the payload until it calls this.
+ */
+void EmulNet::ENfree(char *data) {
+	en_msg *em = ((en_msg *)data) - 1;
+	pool[em->sizeclass].push_back(em);
+}
+
 /**
  * FUNCTION NAME: ENsend
  *
  * DESCRIPTION: EmulNet send function
+ * 				The payload is copied exactly once, into a pooled buffer that is
+ * 				handed to the receiver without further copies.
  *
  * RETURNS:
  * size
@@ -93,14 +155,16 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 		return 0;
 	}
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
+	em = ENallocmsg(size);
 	em->size = size;
+	pool_sends++;
 
 	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
 	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
 	memcpy(em + 1, data, size);
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
+	emulnet.inbox[em->to.pack()].push_back(em);
+	emulnet.currbuffsize++;
 
 	int src = *(int *)(myaddr->addr);
 	int time = par->getcurrtime();
@@ -126,51 +190,47 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
  * size
  */
 int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+	return this->ENsend(myaddr, toaddr, (char *)data.data(), (data.length() * sizeof(char)));
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
  * DESCRIPTION: EmulNet receive function
+ * 				Ownership of each pooled buffer passes to the queue; the consumer
+ * 				releases it with ENfree once the message has been handled.
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
-	int i;
-	char* tmp;
 	int sz;
 	en_msg *emsg;
+	int time = par->getcurrtime();
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
-
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	assert(time < MAX_TIME);
+	recv_calls[time]++;
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+	unordered_map<unsigned long long, deque<en_msg *>>::iterator box = emulnet.inbox.find(myaddr->pack());
+	if ( box == emulnet.inbox.end() ) {
+		return 0;
+	}
 
-			(*enq)(queue, (char *)tmp, sz);
+	while ( !box->second.empty() ) {
+		emsg = box->second.front();
+		box->second.pop_front();
+		emulnet.currbuffsize--;
+		recv_scanned[time]++;
 
-			free(emsg);
+		sz = emsg->size;
+		(*enq)(queue, (char *)(emsg+1), sz);
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+		int dst = *(int *)(myaddr->addr);
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+		assert(dst <= MAX_NODES);
 
-			recv_msgs[dst][time]++;
-		}
+		recv_msgs[dst][time]++;
 	}
 
 	return 0;
@@ -188,8 +248,19 @@ int EmulNet::ENcleanup() {
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( auto &box : emulnet.inbox ) {
+		while ( !box.second.empty() ) {
+			free(box.second.front());
+			box.second.pop_front();
+		}
+	}
+	emulnet.inbox.clear();
+	emulnet.currbuffsize = 0;
+	for ( i = 0; i < EN_POOL_CLASSES; i++ ) {
+		while ( !pool[i].empty() ) {
+			free(pool[i].back());
+			pool[i].pop_back();
+		}
 	}
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
@@ -215,6 +286,21 @@ int EmulNet::ENcleanup() {
 		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
 	}
 
+	// Receive cost per tick: (ENrecv calls, inbox entries touched)
+	int calls_total = 0, scanned_total = 0;
+	fprintf(file, "recv cost ");
+	for ( j = 0; j < par->getcurrtime(); j++ ) {
+		calls_total += recv_calls[j];
+		scanned_total += recv_scanned[j];
+		fprintf(file, " (%4d, %4d)", recv_calls[j], recv_scanned[j]);
+		if (j % 10 == 9) {
+			fprintf(file, "\n          ");
+		}
+	}
+	fprintf(file, "\n");
+	fprintf(file, "recv cost calls_total %6d  scanned_total %6d\n\n", calls_total, scanned_total);
+	fprintf(file, "buffer pool sends %6d  mallocs %6d  reuses %6d\n", pool_sends, pool_mallocs, pool_reuses);
+
 	fclose(file);
 	return 0;
 }
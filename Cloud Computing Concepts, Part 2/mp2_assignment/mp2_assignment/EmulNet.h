@@ -10,6 +10,9 @@
 #define MAX_NODES 1000
 #define MAX_TIME 3600
 #define ENBUFFSIZE 30000
+// Pooled message buffers come in power-of-two slabs from 64 B to 8 KB of payload
+#define EN_POOL_CLASSES 8
+#define EN_POOL_MIN_SLAB 64
 
 #include "stdincludes.h"
 #include "Params.h"
@@ -23,6 +26,8 @@ using namespace std;
 typedef struct en_msg {
 	// Number of bytes after the class
 	int size;
+	// Slab class of the pooled buffer holding this message
+	int sizeclass;
 	// Source node
 	Address from;
 	// Destination node
@@ -31,23 +36,24 @@ typedef struct en_msg {
 
 /**
  * Class Name: EM
+ *
+ * DESCRIPTION: Messages in flight, held in one inbox per destination node.
+ * 				Inboxes are keyed by the packed destination address so that a
+ * 				receive only touches the messages pending for that node.
  */
 class EM {
 public:
 	int nextid;
+	// Number of messages in flight across all inboxes
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
+	unordered_map<unsigned long long, deque<en_msg *>> inbox;
 	EM() {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->inbox = anotherEM.inbox;
 		return *this;
 	}
 	int getNextId() {
@@ -82,6 +88,16 @@ private:
 	Params* par;
 	int sent_msgs[MAX_NODES + 1][MAX_TIME];
 	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// Receive cost per tick: number of ENrecv calls and inbox entries they touched
+	int recv_calls[MAX_TIME];
+	int recv_scanned[MAX_TIME];
+	// Free lists of recycled message buffers, one per slab class
+	vector<en_msg *> pool[EN_POOL_CLASSES];
+	// Buffer pool counters: sends accepted, fresh mallocs, recycled buffers
+	int pool_sends;
+	int pool_mallocs;
+	int pool_reuses;
+	en_msg *ENallocmsg(int size);
 	int enInited;
 	EM emulnet;
 public:
@@ -93,6 +109,7 @@ public:
 	int ENsend(Address *myaddr, Address *toaddr, string data);
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	void ENfree(char *data);
 	int ENcleanup();
 };
 
@@ -21,21 +21,14 @@ Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
  * DESCRIPTION: Convert string to get an Entry object
  */
 Entry::Entry(string entry){
-	vector<string> tuple;
 	this->delimiter = ":";
-	size_t pos = entry.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = entry.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + delimiter.size();
-		pos = entry.find(delimiter, start);
-	}
-	tuple.push_back(entry.substr(start));
+	// The value may hold the delimiter itself, so the fields are split from the right
+	size_t replicaPos = entry.rfind(delimiter);
+	size_t timestampPos = entry.rfind(delimiter, replicaPos - 1);
 
-	value = tuple.at(0);
-	timestamp = stoi(tuple.at(1));
-	replica = static_cast<ReplicaType>(stoi(tuple.at(2)));
+	value = entry.substr(0, timestampPos);
+	timestamp = stoi(entry.substr(timestampPos + delimiter.size(), replicaPos - timestampPos - delimiter.size()));
+	replica = static_cast<ReplicaType>(stoi(entry.substr(replicaPos + delimiter.size())));
 }
 
 /**
@@ -46,3 +39,16 @@ Entry::Entry(string entry){
 string Entry::convertToString() {
 	return value + delimiter + to_string(timestamp) + delimiter + to_string(replica);
 }
+
+/**
+ * FUNCTION NAME: isNewerThan
+ *
+ * DESCRIPTION: Whether this version of a key wins over other: the later timestamp
+ * 				wins, and the greater value breaks ties so every replica picks the same
+ */
+bool Entry::isNewerThan(const Entry &other) {
+	if ( timestamp != other.timestamp ) {
+		return timestamp > other.timestamp;
+	}
+	return value > other.value;
+}
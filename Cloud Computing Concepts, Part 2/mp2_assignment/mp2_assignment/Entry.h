@@ -4,6 +4,9 @@
  * DESCRIPTION: Header file Entry class
  **********************************/
 
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
 #include "stdincludes.h"
 #include "Message.h"
 
@@ -22,4 +25,7 @@ public:
 	Entry(string entry);
 	Entry(string _value, int _timestamp, ReplicaType _replica);
 	string convertToString();
+	bool isNewerThan(const Entry &other);
 };
+
+#endif /* ENTRY_H_ */
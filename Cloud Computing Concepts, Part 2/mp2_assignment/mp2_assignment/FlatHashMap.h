@@ -0,0 +1,192 @@
+/**********************************
+ * FILE NAME: FlatHashMap.h
+ *
+ * DESCRIPTION: Header file of the open addressing hash table used as the
+ * 				storage engine of HashTable
+ **********************************/
+
+#ifndef FLATHASHMAP_H_
+#define FLATHASHMAP_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+#define FLATHASHMAP_MIN_CAPACITY 16
+// grow when size exceeds MAX_LOAD_NUM / MAX_LOAD_DEN of the capacity
+#define FLATHASHMAP_MAX_LOAD_NUM 3
+#define FLATHASHMAP_MAX_LOAD_DEN 4
+
+/**
+ * CLASS NAME: FlatHashMap
+ *
+ * DESCRIPTION: Hash table with linear probing over one contiguous slot array,
+ * 				string keyed unless K says otherwise. Every slot stores the full
+ * 				hash of its key, so a probe only compares keys whose hashes match,
+ * 				and short keys live inline in the slot (small string optimization).
+ * 				Erase uses backward shift deletion, so there are no tombstones and
+ * 				lookups stay short. The interface is the subset of std::map used by
+ * 				HashTable and MembershipTable.
+ */
+template <class V, class K = string>
+class FlatHashMap {
+public:
+	typedef pair<K, V> value_type;
+
+private:
+	struct Slot {
+		// 0 marks an empty slot; real hashes are forced non-zero
+		size_t hash;
+		value_type kv;
+		Slot(): hash(0) {}
+	};
+	vector<Slot> slots;
+	size_t mask;
+	size_t used;
+
+	static size_t hashOf(const K &key) {
+		size_t h = std::hash<K>()(key);
+		return h ? h : 1;
+	}
+
+	/**
+	 * FUNCTION NAME: probe
+	 *
+	 * DESCRIPTION: Index of the slot holding key, or of the empty slot where it would go
+	 */
+	size_t probe(const K &key, size_t h) const {
+		size_t i = h & mask;
+		while ( slots[i].hash != 0 && (slots[i].hash != h || slots[i].kv.first != key) ) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	void rehash(size_t capacity) {
+		vector<Slot> old;
+		old.swap(slots);
+		slots.resize(capacity);
+		mask = capacity - 1;
+		for ( size_t i = 0; i < old.size(); i++ ) {
+			if ( old[i].hash != 0 ) {
+				size_t j = old[i].hash & mask;
+				while ( slots[j].hash != 0 ) {
+					j = (j + 1) & mask;
+				}
+				slots[j].hash = old[i].hash;
+				slots[j].kv = std::move(old[i].kv);
+			}
+		}
+	}
+
+public:
+	/**
+	 * CLASS NAME: iterator
+	 *
+	 * DESCRIPTION: Forward iterator over the occupied slots
+	 */
+	class iterator {
+		friend class FlatHashMap;
+		Slot *pos;
+		Slot *last;
+		void skip() {
+			while ( pos != last && pos->hash == 0 ) {
+				pos++;
+			}
+		}
+	public:
+		iterator(): pos(NULL), last(NULL) {}
+		iterator(Slot *pos, Slot *last): pos(pos), last(last) { skip(); }
+		value_type& operator*() const { return pos->kv; }
+		value_type* operator->() const { return &pos->kv; }
+		iterator& operator++() { pos++; skip(); return *this; }
+		bool operator==(const iterator &another) const { return pos == another.pos; }
+		bool operator!=(const iterator &another) const { return pos != another.pos; }
+	};
+
+	FlatHashMap(): mask(FLATHASHMAP_MIN_CAPACITY - 1), used(0) {
+		slots.resize(FLATHASHMAP_MIN_CAPACITY);
+	}
+
+	iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+	iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+	size_t size() const { return used; }
+	bool empty() const { return used == 0; }
+
+	iterator find(const K &key) {
+		size_t i = probe(key, hashOf(key));
+		if ( slots[i].hash == 0 ) {
+			return end();
+		}
+		return iterator(&slots[i], slots.data() + slots.size());
+	}
+
+	size_t count(const K &key) const {
+		return slots[probe(key, hashOf(key))].hash != 0 ? 1 : 0;
+	}
+
+	/**
+	 * FUNCTION NAME: emplace
+	 *
+	 * DESCRIPTION: Insert key if absent; an existing value is left untouched
+	 */
+	pair<iterator, bool> emplace(const K &key, const V &value) {
+		if ( (used + 1) * FLATHASHMAP_MAX_LOAD_DEN > slots.size() * FLATHASHMAP_MAX_LOAD_NUM ) {
+			rehash(slots.size() * 2);
+		}
+		size_t h = hashOf(key);
+		size_t i = probe(key, h);
+		bool inserted = false;
+		if ( slots[i].hash == 0 ) {
+			slots[i].hash = h;
+			slots[i].kv.first = key;
+			slots[i].kv.second = value;
+			used++;
+			inserted = true;
+		}
+		return make_pair(iterator(&slots[i], slots.data() + slots.size()), inserted);
+	}
+
+	/**
+	 * FUNCTION NAME: erase
+	 *
+	 * DESCRIPTION: Remove key, shifting later entries of its probe run back one slot
+	 *
+	 * RETURNS:
+	 * number of entries erased (0 or 1)
+	 */
+	size_t erase(const K &key) {
+		size_t i = probe(key, hashOf(key));
+		if ( slots[i].hash == 0 ) {
+			return 0;
+		}
+		size_t j = i;
+		while ( true ) {
+			j = (j + 1) & mask;
+			if ( slots[j].hash == 0 ) {
+				break;
+			}
+			// Move j back to the hole unless its home slot lies cyclically in (i, j]
+			size_t home = slots[j].hash & mask;
+			if ( (j > i) ? (home <= i || home > j) : (home <= i && home > j) ) {
+				slots[i].hash = slots[j].hash;
+				slots[i].kv = std::move(slots[j].kv);
+				i = j;
+			}
+		}
+		slots[i].hash = 0;
+		slots[i].kv = value_type();
+		used--;
+		return 1;
+	}
+
+	void clear() {
+		slots.clear();
+		slots.resize(FLATHASHMAP_MIN_CAPACITY);
+		mask = FLATHASHMAP_MIN_CAPACITY - 1;
+		used = 0;
+	}
+};
+
+#endif /* FLATHASHMAP_H_ */
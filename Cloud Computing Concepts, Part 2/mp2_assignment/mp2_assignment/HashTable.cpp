@@ -34,7 +34,7 @@ bool HashTable::create(string key, string value) {
  * else it returns a NULL
  */
 string HashTable::read(string key) {
-	map<string, string>::iterator search;
+	HashTableEngine::iterator search;
 
 	search = hashTable.find(key);
 	if ( search != hashTable.end() ) {
@@ -58,15 +58,15 @@ string HashTable::read(string key) {
  * false on FAILURE
  */
 bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
+	HashTableEngine::iterator update;
 
-	if (read(key).empty()) {
+	update = hashTable.find(key);
+	if ( update == hashTable.end() || update->second.empty() ) {
 		// Key not found
 		return false;
 	}
 	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
+	update->second = newValue;
 	// Update successful
 	return true;
 }
@@ -83,10 +83,6 @@ bool HashTable::update(string key, string newValue) {
 bool HashTable::deleteKey(string key) {
 	uint eraseCount = 0;
 
-	if (read(key).empty()) {
-		// Key not found
-		return false;
-	}
 	eraseCount = hashTable.erase(key);
 	if ( eraseCount < 1 ) {
 		// Could not erase
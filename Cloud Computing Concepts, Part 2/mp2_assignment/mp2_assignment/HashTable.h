@@ -13,16 +13,25 @@
 #include "stdincludes.h"
 #include "common.h"
 #include "Entry.h"
+#include "FlatHashMap.h"
+
+// Storage engine: the flat open addressing table by default.
+// Define HASHTABLE_STD_MAP to fall back to the ordered std::map.
+#ifdef HASHTABLE_STD_MAP
+typedef map<string, string> HashTableEngine;
+#else
+typedef FlatHashMap<string> HashTableEngine;
+#endif
 
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: This class is a wrapper to the key value storage engine.
  *
  */
 class HashTable {
 public:
-	map<string, string> hashTable;
+	HashTableEngine hashTable;
 //public:
 	HashTable();
 	bool create(string key, string value);
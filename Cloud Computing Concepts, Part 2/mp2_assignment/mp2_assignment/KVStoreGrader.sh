@@ -50,6 +50,10 @@ QUORUMPLUSONE=3
 UPDATE_OPERATION="UPDATE OPERATION"
 UPDATE_SUCCESS="update success"
 UPDATE_FAILURE="update fail"
+NODE_REMOVED="removed at time"
+CALLBACK="CALLBACK"
+# ticks a coordinator waits for replies before failing a request, TIMEOUT of MP2Node
+TIMEOUT=40
 
 echo ""
 echo "############################"
@@ -127,8 +131,10 @@ echo ""
 
 DELETE_TEST1_STATUS="${SUCCESS}"
 DELETE_TEST2_STATUS="${SUCCESS}"
+DELETE_TEST3_STATUS="${SUCCESS}"
 DELETE_TEST1_SCORE=0
 DELETE_TEST2_SCORE=0
+DELETE_TEST3_SCORE=0
 
 if [ "${verbose}" -eq 0 ]
 then
@@ -186,6 +192,14 @@ then
 	DELETE_TEST2_STATUS="${FAILURE}"
 fi
 
+echo "TEST 3: Read at ONE after a delete missed a replica"
+
+repair_check_count=`grep -i "READ REPAIR CHECK" dbg.log | grep "deleted on 2 of 2" | wc -l`
+if [ "${repair_check_count}" -ne 1 ]
+then
+	DELETE_TEST3_STATUS="${FAILURE}"
+fi
+
 if [ "${DELETE_TEST1_STATUS}" -eq "${SUCCESS}" ]
 then
 	DELETE_TEST1_SCORE=3
@@ -196,12 +210,19 @@ then
 	DELETE_TEST2_SCORE=4
 fi
 
+if [ "${DELETE_TEST3_STATUS}" -eq "${SUCCESS}" ]
+then
+	DELETE_TEST3_SCORE=3
+fi
+
 # Display score
 echo "TEST 1 SCORE..................: ${DELETE_TEST1_SCORE} / 3"
 echo "TEST 2 SCORE..................: ${DELETE_TEST2_SCORE} / 4"
+echo "TEST 3 SCORE..................: ${DELETE_TEST3_SCORE} / 3"
 # Add to grade
 GRADE=$(( ${GRADE} + ${DELETE_TEST1_SCORE} ))
 GRADE=$(( ${GRADE} + ${DELETE_TEST2_SCORE} ))
+GRADE=$(( ${GRADE} + ${DELETE_TEST3_SCORE} ))
 
 #echo ""
 #echo "############################"
@@ -633,5 +654,160 @@ GRADE=`echo ${GRADE} ${UPDATE_TEST5_SCORE} | awk '{print $1 + $2}'`
 #echo ""
 
 echo ""
-echo "TOTAL GRADE: ${GRADE} / 90" 
+echo "############################"
+echo " COMPLETION CALLBACK TEST"
+echo "############################"
+echo ""
+
+CALLBACK_TEST1_STATUS="${FAILURE}"
+CALLBACK_TEST1_SCORE=0
+CALLBACK_TEST2_STATUS="${FAILURE}"
+CALLBACK_TEST2_SCORE=0
+
+if [ "${verbose}" -eq 0 ]
+then
+    make clean > /dev/null 2>&1
+    make > /dev/null 2>&1
+    if [ $? -ne "${SUCCESS}" ]
+    then
+    	echo "COMPILATION ERROR !!!"
+    	exit
+    fi
+    ./Application ./testcases/read.conf > /dev/null 2>&1
+else
+	make clean
+	make
+	if [ $? -ne "${SUCCESS}" ]
+	then
+    	echo "COMPILATION ERROR !!!"
+    	exit
+    fi
+	./Application ./testcases/read.conf
+fi
+
+echo "TEST 1: Every completion callback reports what the coordinator logged"
+echo "TEST 2: A request that timed out reports its failure and latency"
+
+# Match every callback to the coordinator log line of its transID and key, and
+# compare status, value, and completion time, which must be the issue time plus
+# the latency. Prints the requests matched, the mismatches, and the timeouts.
+callback_counts=`grep -e "coordinator: " -e "${CALLBACK} " dbg.log | awk -v timeout="${TIMEOUT}" '
+function field(name,    i, v) {
+	for ( i = 1; i <= NF; i++ ) {
+		if ( index($i, name "=") == 1 ) {
+			v = substr($i, length(name) + 2)
+			sub(/,$/, "", v)
+			return v
+		}
+	}
+	return ""
+}
+{
+	time = $2
+	gsub(/[][]/, "", time)
+	id = field("transID") " " field("key")
+}
+$3 == "coordinator:" {
+	type[id] = toupper($4)
+	status[id] = ($5 == "success") ? "success" : "failure"
+	at[id] = time
+	values[id] = field("value")
+	coordinators++
+}
+$3 == "'"${CALLBACK}"'" {
+	callbacks++
+	latency = field("latency")
+	if ( !(id in type) || type[id] != $4 || status[id] != field("status") || values[id] != field("value") \
+			|| at[id] != time || field("issued") + latency != time ) {
+		mismatches++
+	} else if ( field("status") == "failure" && latency > timeout ) {
+		timeouts++
+	}
+}
+END {
+	if ( callbacks != coordinators ) {
+		mismatches++
+	}
+	print callbacks + 0, mismatches + 0, timeouts + 0
+}'`
+callback_count=`echo "${callback_counts}" | cut -d" " -f1`
+callback_mismatch_count=`echo "${callback_counts}" | cut -d" " -f2`
+callback_timeout_count=`echo "${callback_counts}" | cut -d" " -f3`
+
+if [ "${callback_count}" -gt 0 -a "${callback_mismatch_count}" -eq 0 ]
+then
+	CALLBACK_TEST1_STATUS="${SUCCESS}"
+fi
+if [ "${callback_timeout_count}" -ge 1 ]
+then
+	CALLBACK_TEST2_STATUS="${SUCCESS}"
+fi
+
+if [ "${CALLBACK_TEST1_STATUS}" -eq "${SUCCESS}" ]
+then
+	CALLBACK_TEST1_SCORE=3
+fi
+if [ "${CALLBACK_TEST2_STATUS}" -eq "${SUCCESS}" ]
+then
+	CALLBACK_TEST2_SCORE=3
+fi
+
+# Display score
+echo "TEST 1 SCORE..................: ${CALLBACK_TEST1_SCORE} / 3"
+echo "TEST 2 SCORE..................: ${CALLBACK_TEST2_SCORE} / 3"
+# Add to grade
+GRADE=$(( ${GRADE} + ${CALLBACK_TEST1_SCORE} ))
+GRADE=$(( ${GRADE} + ${CALLBACK_TEST2_SCORE} ))
+
+echo ""
+echo "############################"
+echo " MEMBERSHIP TEST"
+echo "############################"
+echo ""
+
+MEMBERSHIP_TEST1_STATUS="${FAILURE}"
+MEMBERSHIP_TEST1_SCORE=0
+
+if [ "${verbose}" -eq 0 ]
+then
+    make clean > /dev/null 2>&1
+    make > /dev/null 2>&1
+    if [ $? -ne "${SUCCESS}" ]
+    then
+    	echo "COMPILATION ERROR !!!"
+    	exit
+    fi
+    ./Application ./testcases/delta.conf > /dev/null 2>&1
+else
+	make clean
+	make
+	if [ $? -ne "${SUCCESS}" ]
+	then
+    	echo "COMPILATION ERROR !!!"
+    	exit
+    fi
+	./Application ./testcases/delta.conf
+fi
+
+echo "TEST 1: No live member is removed with delta gossip at 100 nodes"
+
+removed_count=`grep -i "${NODE_REMOVED}" dbg.log | wc -l`
+delta_create_success_count=`grep -i "${CREATE_SUCCESS}" dbg.log | grep "coordinator" | wc -l`
+if [ "${removed_count}" -eq 0 -a "${delta_create_success_count}" -eq 100 ]
+then
+	MEMBERSHIP_TEST1_STATUS="${SUCCESS}"
+fi
+
+if [ "${MEMBERSHIP_TEST1_STATUS}" -eq "${SUCCESS}" ]
+then
+	MEMBERSHIP_TEST1_SCORE=3
+fi
+
+# Display score
+echo "TEST 1 SCORE..................: ${MEMBERSHIP_TEST1_SCORE} / 3"
+# Add to grade
+GRADE=$(( ${GRADE} + ${MEMBERSHIP_TEST1_SCORE} ))
+
+echo ""
+echo "TOTAL GRADE: ${GRADE} / 102" 
 echo ""
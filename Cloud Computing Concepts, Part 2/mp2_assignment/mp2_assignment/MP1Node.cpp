@@ -25,6 +25,13 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
 	this->log = log;
 	this->par = params;
 	this->memberNode->addr = *address;
+	this->bytesSent = 0;
+	this->rounds = 0;
+	this->incarnation = 0;
+	this->seq = 0;
+	this->probeNext = 0;
+	this->joinDeadline = 0;
+	this->joinSent = 0;
 }
 
 /**
@@ -119,7 +126,6 @@ int MP1Node::initThisNode(Address *joinaddr) {
  * DESCRIPTION: Join the distributed system
  */
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
-	MessageHdr *msg;
 #ifdef DEBUGLOG
     static char s[1024];
 #endif
@@ -132,36 +138,47 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
         memberNode->inGroup = true;
     }
     else {
-        size_t msgsize = sizeof(MessageHdr) + sizeof(joinaddr->addr) + sizeof(long) + 1;
-        msg = (MessageHdr *) malloc(msgsize * sizeof(char));
-
-        // create JOINREQ message: format of data is {struct Address myaddr}
-        msg->msgType = JOINREQ;
-        memcpy((char *)(msg+1), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
-        memcpy((char *)(msg+1) + 1 + sizeof(memberNode->addr.addr), &memberNode->heartbeat, sizeof(long));
-
 #ifdef DEBUGLOG
         sprintf(s, "Trying to join...");
         log->LOG(&memberNode->addr, s);
 #endif
 
-        // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize);
-
-        free(msg);
+        sendJOINREQ(joinaddr);
     }
 
     return 1;
 
 }
 
+/**
+ * FUNCTION NAME: sendJOINREQ
+ *
+ * DESCRIPTION: Ask the introducer to add this node to the group
+ */
+void MP1Node::sendJOINREQ(Address *joinaddr) {
+    size_t msgsize = sizeof(MessageHdr) + sizeof(joinaddr->addr) + sizeof(long) + 1;
+    MessageHdr *msg = (MessageHdr *) malloc(msgsize * sizeof(char));
+
+    // create JOINREQ message: format of data is {struct Address myaddr}
+    msg->msgType = JOINREQ;
+    memcpy((char *)(msg+1), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    memcpy((char *)(msg+1) + 1 + sizeof(memberNode->addr.addr), &memberNode->heartbeat, sizeof(long));
+
+    // send JOINREQ message to introducer member
+    emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize);
+    bytesSent += msgsize;
+    joinSent = par->getcurrtime();
+
+    free(msg);
+}
+
 /**
  * FUNCTION NAME: finishUpThisNode
  *
  * DESCRIPTION: Wind up this node and clean up state
  */
 int MP1Node::finishUpThisNode(){
-  free(memberNode);
+  delete memberNode;
   return 0;
 }
 
@@ -181,6 +198,14 @@ void MP1Node::nodeLoop() {
 
     // Wait until you're in the group...
     if( !memberNode->inGroup ) {
+    	// ...using a JOINREP that lost chunks, or asking again
+    	if ( !joinChunks.empty() && par->getcurrtime() >= joinDeadline ) {
+    		applyJoinList();
+    	}
+    	if ( !memberNode->inGroup && par->getcurrtime() >= joinSent + JOIN_RETRY_PERIOD ) {
+    		Address joinaddr = getJoinAddress();
+    		sendJOINREQ(&joinaddr);
+    	}
     	return;
     }
 
@@ -205,6 +230,8 @@ void MP1Node::checkMessages() {
     	size = memberNode->mp1q.front().size;
     	memberNode->mp1q.pop();
     	recvCallBack((void *)memberNode, (char *)ptr, size);
+    	// Hand the pooled buffer back to EmulNet
+    	emulNet->ENfree((char *)ptr);
     }
     return;
 }
@@ -237,18 +264,12 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
     MessageJOINREP msg;
     memcpy(&msg.id, data+sizeof(MessageHdr), sizeof(int));
     memcpy(&msg.port, data+sizeof(MessageHdr)+sizeof(int), sizeof(short));
-    memcpy(&msg.numberOfMember, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short), sizeof(int));
-    msg.memberList = (MemberListEntry *) malloc(sizeof(MemberListEntry)*msg.numberOfMember);
-    memcpy(msg.memberList, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+sizeof(int), sizeof(MemberListEntry)*msg.numberOfMember);
+    memcpy(&msg.chunk, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short), sizeof(int));
+    memcpy(&msg.chunks, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+sizeof(int), sizeof(int));
+    msg.entries = data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+2*sizeof(int);
+    msg.entriesEnd = data+size;
     
     handleJOINREP(&msg);
-
-    //std::cout << "Test: " << msg.id  << ":" << msg.port << " " << msg.numberOfMember << std::endl;
-    // for(int i=0;i<msg.numberOfMember; i++){
-    // std::cout << msg.memberList[i].id << std::endl;
-    // }
-
-    free(msg.memberList);
   }
 
   // Handle GOSSIP type message
@@ -256,18 +277,45 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
     MessageGOSSIP msg;
     memcpy(&msg.id, data+sizeof(MessageHdr), sizeof(int));
     memcpy(&msg.port, data+sizeof(MessageHdr)+sizeof(int), sizeof(short));
-    memcpy(&msg.numberOfMember, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short), sizeof(int));
-    msg.memberList = (MemberListEntry *) malloc(sizeof(MemberListEntry)*msg.numberOfMember);
-    memcpy(msg.memberList, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+sizeof(int), sizeof(MemberListEntry)*msg.numberOfMember);
+    memcpy(&msg.chunk, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short), sizeof(int));
+    memcpy(&msg.chunks, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+sizeof(int), sizeof(int));
+    msg.entries = data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+2*sizeof(int);
+    msg.entriesEnd = data+size;
     
     handleGOSSIP(&msg);
+  }
+
+  // Handle GOSSIPDIGEST and GOSSIPDIGESTREPLY type messages
+  if (msgHdr->msgType == GOSSIPDIGEST || msgHdr->msgType == GOSSIPDIGESTREPLY) {
+    MessageGOSSIPDIGEST msg;
+    memcpy(&msg.id, data+sizeof(MessageHdr), sizeof(int));
+    memcpy(&msg.port, data+sizeof(MessageHdr)+sizeof(int), sizeof(short));
+    memcpy(&msg.numberOfMember, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short), sizeof(int));
+    memcpy(&msg.digest, data+sizeof(MessageHdr)+sizeof(int)+sizeof(short)+sizeof(int), sizeof(unsigned long long));
 
-    //std::cout << "Test: " << msg.id  << ":" << msg.port << " " << msg.numberOfMember << std::endl;
-    // for(int i=0;i<msg.numberOfMember; i++){
-    // std::cout << msg.memberList[i].id << std::endl;
-    // }
+    handleGOSSIPDIGEST(msgHdr->msgType, &msg);
+  }
 
-    free(msg.memberList);
+  // Handle PING, ACK and PINGREQ type messages
+  if (msgHdr->msgType == PING || msgHdr->msgType == ACK || msgHdr->msgType == PINGREQ) {
+    MessagePROBE msg;
+    size_t offset = sizeof(MessageHdr);
+    memcpy(&msg.id, data+offset, sizeof(int));
+    offset += sizeof(int);
+    memcpy(&msg.port, data+offset, sizeof(short));
+    offset += sizeof(short);
+    memcpy(&msg.seq, data+offset, sizeof(int));
+    offset += sizeof(int);
+    memcpy(&msg.otherId, data+offset, sizeof(int));
+    offset += sizeof(int);
+    memcpy(&msg.otherPort, data+offset, sizeof(short));
+    offset += sizeof(short);
+    memcpy(&msg.numberOfUpdates, data+offset, sizeof(int));
+    offset += sizeof(int);
+    msg.updates = data+offset;
+    msg.updatesEnd = data+size;
+
+    handlePROBE(msgHdr->msgType, &msg);
   }
 
   free(msgHdr);
@@ -277,25 +325,15 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
 
 void MP1Node::handleGOSSIP(MessageGOSSIP * msg) {
 
-  for(int i=0; i < msg->numberOfMember; i++){
-    bool isExist = false;
-    MemberListEntry & e = msg->memberList[i];
+  // Merge with the index as the entries are decoded: one lookup per entry received
+  MembershipTable::unpack(msg->entries, msg->entriesEnd, [this](const MemberListEntry &e) {
 
-    for(int j=0; j < (int) memberNode->memberList.size(); j++){
-      if (e.id == memberNode->memberList[j].id && e.port == memberNode->memberList[j].port) {
-        isExist = true;
-
-        if (e.heartbeat != memberNode->memberList[j].heartbeat && (long)(memberNode->memberList[j].timestamp + memberNode->pingCounter) >= par->getcurrtime()) {
-          memberNode->memberList[j].heartbeat = e.heartbeat;   
-          memberNode->memberList[j].timestamp = (long) par->getcurrtime();   
-        }
-        break;
-      }
+    // Only a newer heartbeat refreshes a member, so stale gossip cannot keep a failed one alive
+    MergeResult merged = table.merge(e, (long) par->getcurrtime(), memberNode->pingCounter);
+    if (merged != MERGE_UNCHANGED) {
+      changed.push_back(MembershipTable::key(e.id, e.port));
     }
-    // Add non exist entries into memberList
-    if (!isExist) {
-      e.timestamp = (long) par->getcurrtime();
-      memberNode->memberList.push_back(e);
+    if (merged == MERGE_ADDED) {
       Address addr;
       memcpy(&addr.addr, &e.id, sizeof(int));
       memcpy(&addr.addr[4], &e.port, sizeof(short));
@@ -305,41 +343,113 @@ void MP1Node::handleGOSSIP(MessageGOSSIP * msg) {
 
     if (e.id == id && e.port == port) {
       memberNode->inGroup = true;
-      continue;
     }
-  }
+  });
 
   return;
 }
 
+/**
+ * FUNCTION NAME: handleGOSSIPDIGEST
+ *
+ * DESCRIPTION: Compare a peer's member set with this one, and send the peer the
+ * 				whole list if they differ. A GOSSIPDIGEST is also answered with this
+ * 				node's digest, so that the peer sends its whole list back and each
+ * 				side learns the members only the other knows. A GOSSIPDIGESTREPLY is
+ * 				not answered with a digest, which ends the exchange.
+ */
+void MP1Node::handleGOSSIPDIGEST(MsgTypes type, MessageGOSSIPDIGEST * msg) {
+  if (msg->numberOfMember == (int) memberNode->memberList.size() && msg->digest == table.digest()) {
+    return;
+  }
+  Address peer;
+  memcpy(&peer.addr, &msg->id, sizeof(int));
+  memcpy(&peer.addr[4], &msg->port, sizeof(short));
+  if (type == GOSSIPDIGEST) {
+    sendDigest(GOSSIPDIGESTREPLY, &peer);
+  }
+  sendMemberList(GOSSIP, memberNode->memberList, &peer, 1);
+}
+
+/**
+ * FUNCTION NAME: sendDigest
+ *
+ * DESCRIPTION: Send the size and digest of this node's member set as a GOSSIPDIGEST
+ * 				or GOSSIPDIGESTREPLY
+ */
+void MP1Node::sendDigest(MsgTypes type, Address *peer) {
+  int memberListSize = memberNode->memberList.size();
+  unsigned long long digest = table.digest();
+  size_t msgsize = sizeof(MessageHdr) + sizeof(int) + sizeof(short) + sizeof(int) + sizeof(unsigned long long);
+  MessageHdr * msg = (MessageHdr *) malloc(msgsize * sizeof(char));
+  msg->msgType = type;
+  memcpy((char *)(msg+1), &id, sizeof(int));
+  memcpy((char *)(msg+1)+sizeof(int), &port, sizeof(short));
+  memcpy((char *)(msg+1)+sizeof(int)+sizeof(short), &memberListSize, sizeof(int));
+  memcpy((char *)(msg+1)+sizeof(int)+sizeof(short)+sizeof(int), &digest, sizeof(unsigned long long));
+  emulNet->ENsend(&memberNode->addr, peer, (char *)msg, msgsize);
+  bytesSent += msgsize;
+  free(msg);
+}
+
+/**
+ * FUNCTION NAME: handleJOINREP
+ *
+ * DESCRIPTION: Collect the chunks of a JOINREP, and join once all have arrived, so
+ * 				that the node starts out with the whole list. A chunk count that
+ * 				differs from the one being collected starts a new reply.
+ */
 void MP1Node::handleJOINREP(MessageJOINREP * msg) {
+  if (memberNode->inGroup || msg->chunk < 0 || msg->chunk >= msg->chunks) {
+    return;
+  }
+  if ((int) joinChunks.size() != msg->chunks) {
+    joinChunks.assign(msg->chunks, false);
+    joinEntries.clear();
+    joinDeadline = par->getcurrtime() + JOIN_REASSEMBLY_TIMEOUT;
+  }
+  if (joinChunks[msg->chunk]) {
+    return;
+  }
+  if (!MembershipTable::unpack(msg->entries, msg->entriesEnd, [this](const MemberListEntry &e) { joinEntries.push_back(e); })) {
+    return;
+  }
+  joinChunks[msg->chunk] = true;
+
+  if (find(joinChunks.begin(), joinChunks.end(), false) == joinChunks.end()) {
+    applyJoinList();
+  }
+}
+
+/**
+ * FUNCTION NAME: applyJoinList
+ *
+ * DESCRIPTION: Add the entries of the JOINREP chunks received to the member list,
+ * 				and join the group if this node is among them
+ */
+void MP1Node::applyJoinList() {
 
   // Add non exist entries into memberList
   // mark itself in the group
-  for(int i=0; i < msg->numberOfMember; i++){
-    bool isExist = false;
-    for(int j=0; j < (int) memberNode->memberList.size(); j++){
-      if (msg->memberList[i].id == memberNode->memberList[j].id && msg->memberList[i].port == memberNode->memberList[j].port) {
-        isExist = true;
-        break;
-      }
-    }
-    if (!isExist) {
-      msg->memberList[i].timestamp = (long) par->getcurrtime();
-      memberNode->memberList.push_back(msg->memberList[i]);
+  for (MemberListEntry &e : joinEntries) {
+    if (table.find(e.id, e.port) == NULL) {
+      e.timestamp = (long) par->getcurrtime();
+      table.add(e);
       Address addr;
-      memcpy(&addr.addr, &msg->memberList[i].id, sizeof(int));
-      memcpy(&addr.addr[4], &msg->memberList[i].port, sizeof(short));
+      memcpy(&addr.addr, &e.id, sizeof(int));
+      memcpy(&addr.addr[4], &e.port, sizeof(short));
       memberNode->nnb++;
       log->logNodeAdd(&memberNode->addr, &addr);
     }
 
-    if (msg->memberList[i].id == id && msg->memberList[i].port == port) {
+    if (e.id == id && e.port == port) {
       memberNode->inGroup = true;
       continue;
     }
   }
-  
+
+  joinChunks.clear();
+  joinEntries.clear();
   return;
 }
 
@@ -350,18 +460,17 @@ void MP1Node::handleJOINREQ(MessageJOINREQ * msg) {
   memcpy(&joinAddr.addr, &msg->id, sizeof(int));
   memcpy(&joinAddr.addr[4], &msg->port, sizeof(short));
 
-  for(const MemberListEntry& e: memberNode->memberList) {
-    if (e.id == msg->id && e.port == msg->port) {
-      inMemberList = true;
-      break;
-    }
-  }
+  inMemberList = table.find(msg->id, msg->port) != NULL;
 
   // Add joiner to its member list if joiner is not in the list
   if (!inMemberList) {
     // Add the entry
-    MemberListEntry * entry = new MemberListEntry(msg->id, msg->port, msg->heartbeat, (long) par->getcurrtime());
-    memberNode->memberList.push_back(*entry);
+    table.add(MemberListEntry(msg->id, msg->port, msg->heartbeat, (long) par->getcurrtime()));
+    changed.push_back(MembershipTable::key(msg->id, msg->port));
+    if (par->DETECTOR == DETECTOR_SWIM) {
+      dead.erase(MembershipTable::key(msg->id, msg->port));
+      enqueueUpdate(SWIM_ALIVE, msg->id, msg->port, msg->heartbeat);
+    }
     // Increase nnb
     memberNode->nnb++;
 
@@ -372,21 +481,48 @@ void MP1Node::handleJOINREQ(MessageJOINREQ * msg) {
   }
 
   // Send the JOINREP back to joiner
-  MemberListEntry * memberListArray = memberNode->memberList.data();
-  int memberListSize = memberNode->memberList.size();
-  size_t replysize = sizeof(MessageHdr) + sizeof(int) + sizeof(short) + sizeof(int) + sizeof(MemberListEntry)*memberListSize;
-  MessageHdr * reply = (MessageHdr *) malloc(replysize * sizeof(char));
-  reply->msgType = JOINREP;
-  memcpy((char *)(reply+1), &id, sizeof(int));
-  memcpy((char *)(reply+1)+sizeof(int), &port, sizeof(short));
-  memcpy((char *)(reply+1)+sizeof(int)+sizeof(short), &memberListSize, sizeof(int));
-  memcpy((char *)(reply+1)+sizeof(int)+sizeof(short)+sizeof(int), memberListArray, sizeof(MemberListEntry)*memberListSize);
+  sendMemberList(JOINREP, memberNode->memberList, &joinAddr, 1);
 
-  emulNet->ENsend(&memberNode->addr, &joinAddr, (char *)reply, replysize);
+  return;
+}
 
-  free(reply);
+/**
+ * FUNCTION NAME: sendMemberList
+ *
+ * DESCRIPTION: Send entries packed as a JOINREP or GOSSIP to each of the n targets,
+ * 				split into as many chunks as it takes for each to fit in MAX_MSG_SIZE.
+ * 				GOSSIP chunks are merged as they arrive; JOINREP chunks are collected
+ * 				by the joiner.
+ */
+void MP1Node::sendMemberList(MsgTypes type, const vector<MemberListEntry> &entries, Address *targets, int n) {
+  size_t header = sizeof(MessageHdr) + sizeof(int) + sizeof(short) + 2*sizeof(int);
+  int perChunk = (int) ((par->MAX_MSG_SIZE - sizeof(en_msg) - header - MembershipTable::packedSize(0) - 1) / MEMBERSHIP_ENTRY_MAX);
+  int total = entries.size();
+  int chunks = max(1, (total + perChunk - 1) / perChunk);
+  MessageHdr * msg = (MessageHdr *) malloc(header + MembershipTable::packedSize(min(total, perChunk)));
+  msg->msgType = type;
+  memcpy((char *)(msg+1), &id, sizeof(int));
+  memcpy((char *)(msg+1)+sizeof(int), &port, sizeof(short));
+  memcpy((char *)(msg+1)+sizeof(int)+sizeof(short)+sizeof(int), &chunks, sizeof(int));
+
+  // In id order the packed ids differ by little
+  vector<MemberListEntry> sorted(entries);
+  sort(sorted.begin(), sorted.end(), [](const MemberListEntry &a, const MemberListEntry &b) {
+    return a.id != b.id ? a.id < b.id : a.port < b.port;
+  });
+
+  for (int chunk = 0; chunk < chunks; chunk++) {
+    int memberListSize = min(perChunk, total - chunk*perChunk);
+    memcpy((char *)(msg+1)+sizeof(int)+sizeof(short), &chunk, sizeof(int));
+    size_t msgsize = MembershipTable::pack(sorted.data() + chunk*perChunk, memberListSize, (char *)msg+header) - (char *)msg;
+
+    for (int i = 0; i < n; i++) {
+      emulNet->ENsend(&memberNode->addr, &targets[i], (char *)msg, msgsize);
+      bytesSent += msgsize;
+    }
+  }
 
-  return;
+  free(msg);
 }
 
 
@@ -405,6 +541,13 @@ void MP1Node::nodeLoopOps() {
   // Increase its heartbeat  
   memberNode->heartbeat++;
 
+  // SWIM probes members instead of gossiping heartbeats
+  if (par->DETECTOR == DETECTOR_SWIM) {
+    rounds++;
+    swimLoopOps();
+    return;
+  }
+
   // Update new membership list
   for(int j=0; j < (int) memberNode->memberList.size(); j++){
     MemberListEntry * e = &memberNode->memberList[j];
@@ -422,42 +565,381 @@ void MP1Node::nodeLoopOps() {
         memberNode->nnb--;
         log->logNodeRemove(&memberNode->addr, &address); 
       }
+      table.bury(*e, (long) par->getcurrtime());
       continue;
     }
+    e->suspected = (long) (e->timestamp + TSUSPECT) < par->getcurrtime();
     newMemberList.push_back(*e);
   }
 
   // Add itself into the member list if it is not in the group
   if (!inMemberList) {
-    MemberListEntry * e = new MemberListEntry(id, port, memberNode->heartbeat, par->getcurrtime());
-    newMemberList.push_back(*e);
+    newMemberList.push_back(MemberListEntry(id, port, memberNode->heartbeat, par->getcurrtime()));
   }
 
   // memberList = new member list
   memberNode->memberList = newMemberList;
+  table.rebuild();
+  table.expireTombstones((long) par->getcurrtime(), memberNode->timeOutCounter);
+
+  rounds++;
+
+  if (par->GOSSIP_MODE == GOSSIP_DELTA) {
+    // Only the entries with a newer heartbeat, each forwarded for about log2(n) rounds
+    // after it last changed: forwarded once, a change dies out before it reaches every
+    // member of a large cluster, which then removes the member
+    vector<MemberListEntry> delta;
+    vector<unsigned long long> done;
+    int limit = DELTA_RETRANSMIT_MULT * (int) ceil(log2(memberNode->memberList.size() + 1));
+    if (memberNode->heartbeat % DELTA_HEARTBEAT_PERIOD == 0) {
+      changed.push_back(MembershipTable::key(id, port));
+    }
+    for (unsigned long long key : changed) {
+      forwarding.erase(key);
+      forwarding.emplace(key, limit);
+    }
+    for (FlatHashMap<int, unsigned long long>::iterator it = forwarding.begin(); it != forwarding.end(); ++it) {
+      MemberListEntry *e = table.find(it->first);
+      if (e != NULL) {
+        delta.push_back(*e);
+      }
+      if (e == NULL || --it->second <= 0) {
+        done.push_back(it->first);
+      }
+    }
+    for (unsigned long long key : done) {
+      forwarding.erase(key);
+    }
+    int n = (int) min(memberNode->nnb-1, DELTA_FANOUT);
+    if (!delta.empty() && n > 0) {
+      vector<Address> randAddrs(n);
+      genRandomAddr(id, port, memberNode, randAddrs.data(), n);
+      sendMemberList(GOSSIP, delta, randAddrs.data(), n);
+    }
+
+    // Now and then make sure a random peer knows the same members, in a few bytes
+    if (memberNode->heartbeat % FULL_SYNC_PERIOD == 0 && memberNode->nnb > 1) {
+      Address peer;
+      genRandomAddr(id, port, memberNode, &peer, 1);
+      sendDigest(GOSSIPDIGEST, &peer);
+    }
+    changed.clear();
+    return;
+  }
+  changed.clear();
 
   // Get random targets
   int n = (int) min(memberNode->nnb-1, numberOfRandomTarget);
 
-  Address * randAddrs = (Address *) malloc(sizeof(Address)*n);
-  genRandomAddr(id, port, memberNode, randAddrs, n);
+  vector<Address> randAddrs(n);
+  genRandomAddr(id, port, memberNode, randAddrs.data(), n);
 
   // Send GOSSIP msg to selected random targets
-  for (int i =0; i < n; i++) {
-    MemberListEntry * memberListArray = memberNode->memberList.data();
-    int memberListSize = memberNode->memberList.size();
-    size_t msgsize = sizeof(MessageHdr) + sizeof(int) + sizeof(short) + sizeof(int) + sizeof(MemberListEntry)*memberListSize;
-    MessageHdr * msg = (MessageHdr *) malloc(msgsize * sizeof(char));
-    msg->msgType = GOSSIP;
-    memcpy((char *)(msg+1), &id, sizeof(int));
-    memcpy((char *)(msg+1)+sizeof(int), &port, sizeof(short));
-    memcpy((char *)(msg+1)+sizeof(int)+sizeof(short), &memberListSize, sizeof(int));
-    memcpy((char *)(msg+1)+sizeof(int)+sizeof(short)+sizeof(int), memberListArray, sizeof(MemberListEntry)*memberListSize);
+  sendMemberList(GOSSIP, memberNode->memberList, randAddrs.data(), n);
+
+  return;
+}
 
-    emulNet->ENsend(&memberNode->addr, &randAddrs[i], (char *)msg, msgsize);
+/**
+ * FUNCTION NAME: swimLoopOps
+ *
+ * DESCRIPTION: One tick of the SWIM failure detector. Every SWIM_PERIOD ticks the
+ * 				next member in a shuffled round robin order is pinged; without an ack
+ * 				within SWIM_ACK_TIMEOUT, SWIM_INDIRECT_K other members are asked to
+ * 				ping it; without one within SWIM_PROBE_TIMEOUT it becomes a suspect,
+ * 				and a suspect that does not refute within SWIM_SUSPECT_TIMEOUT is
+ * 				removed. Membership changes travel piggybacked on the probes, so
+ * 				every node sends about the same number of messages whatever the
+ * 				cluster size.
+ */
+void MP1Node::swimLoopOps() {
+  long now = (long) par->getcurrtime();
+
+  if (table.find(id, port) == NULL) {
+    table.add(MemberListEntry(id, port, incarnation, now));
+  }
+  // Members not suspected are known to be alive now; MP2Node reads the flag
+  for (MemberListEntry &e : memberNode->memberList) {
+    e.suspected = suspects.count(MembershipTable::key(e.id, e.port)) != 0;
+    if (!e.suspected) {
+      e.timestamp = now;
+    }
   }
 
-  return;
+  // Probes still waiting for an ack
+  size_t kept = 0;
+  for (size_t i = 0; i < probes.size(); i++) {
+    SwimProbe &probe = probes[i];
+    MemberListEntry *target = table.find(probe.target);
+    if (target == NULL) {
+      continue;
+    }
+    if (now >= probe.started + SWIM_PROBE_TIMEOUT) {
+      if (suspects.count(probe.target) == 0) {
+        suspects.emplace(probe.target, now);
+        enqueueUpdate(SWIM_SUSPECT, target->id, target->port, target->heartbeat);
+      }
+      continue;
+    }
+    if (!probe.indirect && now >= probe.started + SWIM_ACK_TIMEOUT) {
+      // Ask members other than the target to ping it
+      vector<Address> helpers;
+      for (const MemberListEntry &e : memberNode->memberList) {
+        unsigned long long key = MembershipTable::key(e.id, e.port);
+        if (key != probe.target && !(e.id == id && e.port == port) && suspects.count(key) == 0) {
+          Address addr;
+          memcpy(&addr.addr[0], &e.id, sizeof(int));
+          memcpy(&addr.addr[4], &e.port, sizeof(short));
+          helpers.push_back(addr);
+        }
+      }
+      for (int k = 0; k < SWIM_INDIRECT_K && !helpers.empty(); k++) {
+        size_t pick = rand() % helpers.size();
+        sendProbe(PINGREQ, &helpers[pick], probe.seq, target->id, target->port);
+        helpers[pick] = helpers.back();
+        helpers.pop_back();
+      }
+      probe.indirect = true;
+    }
+    probes[kept++] = probe;
+  }
+  probes.resize(kept);
+
+  // Suspects that did not refute in time have failed
+  vector<unsigned long long> failed;
+  for (auto & [key, since] : suspects) {
+    if (since + SWIM_SUSPECT_TIMEOUT <= now) {
+      failed.push_back(key);
+    }
+  }
+  for (unsigned long long key : failed) {
+    MemberListEntry *e = table.find(key);
+    if (e != NULL) {
+      enqueueUpdate(SWIM_CONFIRM, e->id, e->port, e->heartbeat);
+      dead.emplace(key, e->heartbeat);
+      removeMember(key);
+    }
+    suspects.erase(key);
+  }
+
+  // Ping the next member of the round robin order
+  if (memberNode->heartbeat % SWIM_PERIOD != 0 || memberNode->memberList.size() < 2) {
+    return;
+  }
+  MemberListEntry *target = NULL;
+  for (int tries = 0; target == NULL && tries < 2; tries++) {
+    if (probeNext >= probeOrder.size()) {
+      probeOrder.clear();
+      for (const MemberListEntry &e : memberNode->memberList) {
+        if (!(e.id == id && e.port == port)) {
+          probeOrder.push_back(MembershipTable::key(e.id, e.port));
+        }
+      }
+      // Fisher-Yates on rand(), so the probe order follows the seed of the rest of the simulation
+      for (size_t i = probeOrder.size(); i > 1; i--) {
+        swap(probeOrder[i - 1], probeOrder[rand() % i]);
+      }
+      probeNext = 0;
+    }
+    while (target == NULL && probeNext < probeOrder.size()) {
+      target = table.find(probeOrder[probeNext++]);
+    }
+  }
+  if (target == NULL) {
+    return;
+  }
+  Address addr;
+  memcpy(&addr.addr[0], &target->id, sizeof(int));
+  memcpy(&addr.addr[4], &target->port, sizeof(short));
+  probes.push_back({MembershipTable::key(target->id, target->port), ++seq, (int) now, false});
+  sendProbe(PING, &addr, seq, id, port);
+}
+
+/**
+ * FUNCTION NAME: handlePROBE
+ *
+ * DESCRIPTION: Apply the updates a probe carries, then answer a PING with an ACK,
+ * 				a PINGREQ with a PING on the requester's behalf, and an ACK by ending
+ * 				the probe, or relaying it to the member that started the probe
+ */
+void MP1Node::handlePROBE(MsgTypes type, MessagePROBE * msg) {
+  // The updates are read in place from the received message, which need not be aligned;
+  // a count that runs past the end of the message is cut at it
+  SwimUpdate update;
+  const char *in = msg->updates;
+  for (int i = 0; i < msg->numberOfUpdates && msg->updatesEnd - in >= (ptrdiff_t) sizeof(SwimUpdate); i++) {
+    memcpy(&update, in, sizeof(SwimUpdate));
+    in += sizeof(SwimUpdate);
+    applyUpdate(update);
+  }
+  // A probe from a member whose join this node missed is proof it is alive
+  if (table.find(msg->id, msg->port) == NULL) {
+    applyUpdate({msg->id, msg->port, SWIM_ALIVE, 0});
+  }
+
+  Address sender;
+  memcpy(&sender.addr[0], &msg->id, sizeof(int));
+  memcpy(&sender.addr[4], &msg->port, sizeof(short));
+  Address other;
+  memcpy(&other.addr[0], &msg->otherId, sizeof(int));
+  memcpy(&other.addr[4], &msg->otherPort, sizeof(short));
+
+  if (type == PING) {
+    sendProbe(ACK, &sender, msg->seq, msg->otherId, msg->otherPort);
+  } else if (type == PINGREQ) {
+    sendProbe(PING, &other, msg->seq, msg->id, msg->port);
+  } else if (msg->otherId == id && msg->otherPort == port) {
+    for (size_t i = 0; i < probes.size(); i++) {
+      if (probes[i].seq == msg->seq) {
+        probes.erase(probes.begin() + i);
+        break;
+      }
+    }
+  } else {
+    sendProbe(ACK, &other, msg->seq, msg->otherId, msg->otherPort);
+  }
+}
+
+/**
+ * FUNCTION NAME: sendProbe
+ *
+ * DESCRIPTION: Send a PING, ACK or PINGREQ with the updates sent the fewest times
+ * 				piggybacked; an update is dropped once it has been sent
+ * 				SWIM_RETRANSMIT_MULT * log2(cluster size) times
+ */
+void MP1Node::sendProbe(MsgTypes type, Address *toAddr, int seq, int otherId, short otherPort) {
+  int limit = SWIM_RETRANSMIT_MULT * (int) ceil(log2(memberNode->memberList.size() + 1));
+  stable_sort(updates.begin(), updates.end(), [](const pair<SwimUpdate, int> &a, const pair<SwimUpdate, int> &b) {
+    return a.second < b.second;
+  });
+  int count = (int) min(updates.size(), (size_t) SWIM_PIGGYBACK);
+
+  size_t msgsize = sizeof(MessageHdr) + 3*sizeof(int) + 2*sizeof(short) + sizeof(int) + sizeof(SwimUpdate)*count;
+  MessageHdr * msg = (MessageHdr *) malloc(msgsize * sizeof(char));
+  msg->msgType = type;
+  char *out = (char *)(msg+1);
+  memcpy(out, &id, sizeof(int));
+  out += sizeof(int);
+  memcpy(out, &port, sizeof(short));
+  out += sizeof(short);
+  memcpy(out, &seq, sizeof(int));
+  out += sizeof(int);
+  memcpy(out, &otherId, sizeof(int));
+  out += sizeof(int);
+  memcpy(out, &otherPort, sizeof(short));
+  out += sizeof(short);
+  memcpy(out, &count, sizeof(int));
+  out += sizeof(int);
+  for (int i = 0; i < count; i++) {
+    memcpy(out, &updates[i].first, sizeof(SwimUpdate));
+    out += sizeof(SwimUpdate);
+    updates[i].second++;
+  }
+
+  emulNet->ENsend(&memberNode->addr, toAddr, (char *)msg, msgsize);
+  bytesSent += msgsize;
+  free(msg);
+
+  updates.erase(remove_if(updates.begin(), updates.end(), [limit](const pair<SwimUpdate, int> &update) {
+    return update.second >= limit;
+  }), updates.end());
+}
+
+/**
+ * FUNCTION NAME: applyUpdate
+ *
+ * DESCRIPTION: Apply one piggybacked update, passing it on if it was news. A higher
+ * 				incarnation overrides anything; at the same incarnation a suspicion
+ * 				overrides alive, and a confirmed failure overrides both. A node that
+ * 				hears it is suspected refutes it with a higher incarnation.
+ */
+void MP1Node::applyUpdate(const SwimUpdate &update) {
+  unsigned long long key = MembershipTable::key(update.id, update.port);
+  MemberListEntry *e = table.find(key);
+
+  if (update.id == id && update.port == port) {
+    if (update.type != SWIM_ALIVE && update.incarnation >= incarnation) {
+      incarnation = update.incarnation + 1;
+      if (e != NULL) {
+        e->heartbeat = incarnation;
+      }
+      enqueueUpdate(SWIM_ALIVE, id, port, incarnation);
+    }
+    return;
+  }
+
+  switch (update.type) {
+    case SWIM_ALIVE: {
+      FlatHashMap<int, unsigned long long>::iterator gone = dead.find(key);
+      if (gone != dead.end() && gone->second >= update.incarnation) {
+        return;
+      }
+      if (e == NULL) {
+        dead.erase(key);
+        table.add(MemberListEntry(update.id, update.port, update.incarnation, (long) par->getcurrtime()));
+        Address addr;
+        memcpy(&addr.addr[0], &update.id, sizeof(int));
+        memcpy(&addr.addr[4], &update.port, sizeof(short));
+        memberNode->nnb++;
+        log->logNodeAdd(&memberNode->addr, &addr);
+      } else if (update.incarnation > e->heartbeat) {
+        e->heartbeat = update.incarnation;
+        suspects.erase(key);
+      } else {
+        return;
+      }
+      break;
+    }
+    case SWIM_SUSPECT:
+      if (e == NULL || update.incarnation < e->heartbeat || (update.incarnation == e->heartbeat && suspects.count(key))) {
+        return;
+      }
+      e->heartbeat = update.incarnation;
+      if (suspects.count(key) == 0) {
+        suspects.emplace(key, (long) par->getcurrtime());
+      }
+      break;
+    case SWIM_CONFIRM:
+      if (e == NULL) {
+        return;
+      }
+      dead.emplace(key, update.incarnation);
+      suspects.erase(key);
+      removeMember(key);
+      break;
+  }
+  enqueueUpdate(update.type, update.id, update.port, update.incarnation);
+}
+
+/**
+ * FUNCTION NAME: enqueueUpdate
+ *
+ * DESCRIPTION: Piggyback an update on the next probes, replacing any older one
+ * 				about the same member
+ */
+void MP1Node::enqueueUpdate(int type, int id, short port, int incarnation) {
+  SwimUpdate update = {id, port, type, incarnation};
+  for (pair<SwimUpdate, int> &queued : updates) {
+    if (queued.first.id == id && queued.first.port == port) {
+      queued = {update, 0};
+      return;
+    }
+  }
+  updates.push_back({update, 0});
+}
+
+/**
+ * FUNCTION NAME: removeMember
+ *
+ * DESCRIPTION: Remove a member SWIM found to have failed
+ */
+void MP1Node::removeMember(unsigned long long key) {
+  Address address;
+  memcpy(&address.addr[0], &key, sizeof(address.addr));
+  if (table.remove(key)) {
+    memberNode->nnb--;
+    log->logNodeRemove(&memberNode->addr, &address);
+  }
 }
 
 /**
@@ -491,6 +973,7 @@ Address MP1Node::getJoinAddress() {
  */
 void MP1Node::initMemberListTable(Member *memberNode) {
 	memberNode->memberList.clear();
+	table.attach(&memberNode->memberList);
 }
 
 /**
@@ -505,7 +988,7 @@ void MP1Node::printAddress(Address *addr)
 }
 
 void MP1Node::genRandomAddr(int id, short port, Member *memberNode, Address *address, int n) {
-  bitset<512> bitmap = 0; 
+  vector<bool> bitmap(memberNode->memberList.size(), false);
   int i;
   char addr[6];
   int count = 0;
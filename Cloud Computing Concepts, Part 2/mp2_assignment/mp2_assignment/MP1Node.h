@@ -14,13 +14,38 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
-#include <bitset>
+#include "MembershipTable.h"
 
 /**
  * Macros
  */
 #define TREMOVE 20
 #define TFAIL 10
+// Ticks without a newer heartbeat before a member is marked suspected, so that MP2Node
+// holds writes for it as hints instead of sending them
+#define TSUSPECT 5
+// Delta gossip: targets per round, rounds a change is forwarded per log2 of the cluster
+// size, how often a node announces its own heartbeat, and how often it checks its member
+// set against a random peer's
+#define DELTA_FANOUT 3
+#define DELTA_RETRANSMIT_MULT 1
+#define DELTA_HEARTBEAT_PERIOD 2
+#define FULL_SYNC_PERIOD 10
+// Ticks a joiner waits for the missing JOINREP chunks before using those it has,
+// and for being in the group before it sends JOINREQ again
+#define JOIN_REASSEMBLY_TIMEOUT 4
+#define JOIN_RETRY_PERIOD 10
+// SWIM: ticks between probes, ticks a probe waits for a direct ack before asking
+// SWIM_INDIRECT_K members to probe for it, ticks before the target becomes a suspect,
+// ticks a suspect has to refute it, updates piggybacked per message, and times an
+// update is sent, per log2 of the cluster size
+#define SWIM_PERIOD 2
+#define SWIM_ACK_TIMEOUT 2
+#define SWIM_INDIRECT_K 3
+#define SWIM_PROBE_TIMEOUT 6
+#define SWIM_SUSPECT_TIMEOUT 6
+#define SWIM_PIGGYBACK 6
+#define SWIM_RETRANSMIT_MULT 3
 
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
@@ -33,6 +58,11 @@ enum MsgTypes{
     JOINREQ,
     JOINREP,
     GOSSIP,
+    GOSSIPDIGEST,
+    GOSSIPDIGESTREPLY,
+    PING,
+    ACK,
+    PINGREQ,
     DUMMYLASTMSGTYPE
 };
 
@@ -52,21 +82,78 @@ typedef struct MessageJOINREQ {
 }MessageJOINREQ;
 
 
+// JOINREP and GOSSIP carry the list in chunks of at most what fits in MAX_MSG_SIZE,
+// chunk being the index of this one among chunks. entries points at its packed
+// entries (see MembershipTable::pack) in the receive buffer.
 typedef struct MessageJOINREP {
   int id;
   short port;
-  int numberOfMember;
-  MemberListEntry * memberList;
+  int chunk;
+  int chunks;
+  const char * entries;
+  const char * entriesEnd;
 }MessageJOINREP;
 
 
 typedef struct MessageJOINGOSSIP {
   int id;
   short port;
-  int numberOfMember;
-  MemberListEntry * memberList;
+  int chunk;
+  int chunks;
+  const char * entries;
+  const char * entriesEnd;
 }MessageGOSSIP;
 
+typedef struct MessageGOSSIPDIGEST {
+  int id;
+  short port;
+  int numberOfMember;
+  unsigned long long digest;
+}MessageGOSSIPDIGEST;
+
+/**
+ * SWIM membership updates, piggybacked on probes
+ */
+enum SwimUpdateType {
+    SWIM_ALIVE,
+    SWIM_SUSPECT,
+    SWIM_CONFIRM
+};
+
+typedef struct SwimUpdate {
+  int id;
+  short port;
+  int type;
+  int incarnation;
+}SwimUpdate;
+
+// PING, ACK and PINGREQ. other is the member a PINGREQ asks to probe, and in a PING
+// or ACK the member that started the probe, which the ACK ends up with; seq is the
+// probe number of that member. updates points at numberOfUpdates SwimUpdates in the
+// receive buffer, which ends at updatesEnd.
+typedef struct MessagePROBE {
+  int id;
+  short port;
+  int seq;
+  int otherId;
+  short otherPort;
+  int numberOfUpdates;
+  const char * updates;
+  const char * updatesEnd;
+}MessagePROBE;
+
+/**
+ * STRUCT NAME: SwimProbe
+ *
+ * DESCRIPTION: A probe waiting for its ack
+ */
+struct SwimProbe {
+  unsigned long long target;
+  int seq;
+  int started;
+  bool indirect;
+};
+
 /**
  * CLASS NAME: MP1Node
  *
@@ -82,12 +169,48 @@ private:
   int id;
   short port;
   int numberOfRandomTarget;
+  // memberList indexed by (id, port)
+  MembershipTable table;
+  // packed (id, port) of the entries that changed since the last gossip round
+  vector<unsigned long long> changed;
+  // delta gossip: packed (id, port) of the entries being forwarded -> rounds left
+  FlatHashMap<int, unsigned long long> forwarding;
+  // membership bytes sent, and gossip rounds run
+  unsigned long bytesSent;
+  int rounds;
+  // SWIM: own incarnation, last probe number, probes waiting for an ack, the round
+  // robin order of probe targets and the next one
+  int incarnation;
+  int seq;
+  vector<SwimProbe> probes;
+  vector<unsigned long long> probeOrder;
+  size_t probeNext;
+  // updates to piggyback, with the times each has been sent
+  vector<pair<SwimUpdate, int>> updates;
+  // time each suspect was suspected, and the incarnation each confirmed failure had
+  FlatHashMap<long, unsigned long long> suspects;
+  FlatHashMap<int, unsigned long long> dead;
+  // JOINREP chunks seen so far, their entries, and the tick by which the rest must
+  // arrive; the tick the last JOINREQ was sent
+  vector<bool> joinChunks;
+  vector<MemberListEntry> joinEntries;
+  int joinDeadline;
+  int joinSent;
 
 public:
 	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
 	Member * getMemberNode() {
 		return memberNode;
 	}
+	unsigned long getBytesSent() {
+		return bytesSent;
+	}
+	int getRounds() {
+		return rounds;
+	}
+	MembershipTable * getMembershipTable() {
+		return &table;
+	}
 	int recvLoop();
 	static int enqueueWrapper(void *env, char *buff, int size);
 	void nodeStart(char *servaddrstr, short serverport);
@@ -103,8 +226,19 @@ public:
 	void initMemberListTable(Member *memberNode);
 	void printAddress(Address *addr);
   void handleJOINREQ(MessageJOINREQ * msg);
+  void sendJOINREQ(Address *joinaddr);
   void handleJOINREP(MessageJOINREP * msg);
+  void applyJoinList();
   void handleGOSSIP(MessageGOSSIP * msg);
+  void handleGOSSIPDIGEST(MsgTypes type, MessageGOSSIPDIGEST * msg);
+  void sendDigest(MsgTypes type, Address *peer);
+  void sendMemberList(MsgTypes type, const vector<MemberListEntry> &entries, Address *targets, int n);
+  void swimLoopOps();
+  void handlePROBE(MsgTypes type, MessagePROBE * msg);
+  void sendProbe(MsgTypes type, Address *toAddr, int seq, int otherId, short otherPort);
+  void applyUpdate(const SwimUpdate &update);
+  void enqueueUpdate(int type, int id, short port, int incarnation);
+  void removeMember(unsigned long long key);
   void genRandomAddr(int id, short port, Member *memberNode, Address *address, int n);
 	virtual ~MP1Node();
 };
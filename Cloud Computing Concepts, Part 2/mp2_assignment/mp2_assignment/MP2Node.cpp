@@ -6,6 +6,16 @@
 #include "MP2Node.h"
 
 #define TIMEOUT 40
+// ticks a digest READ waits for its full value before fetching it from the digest replicas
+#define DIGEST_WAIT 3
+// ticks before the first retry to the replicas that have not answered; doubles on every retry
+#define RETRY_TIMEOUT 4
+// writes a replica remembers to answer retries
+#define DEDUP_CACHE_SIZE 4096
+// cancel hints held for one replica; the oldest are dropped beyond this
+#define CANCEL_HINTS_MAX 16
+// cancelled READs a replica remembers
+#define CANCEL_CACHE_SIZE 1024
 
 /**
  * constructor
@@ -15,8 +25,10 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
+	this->members = NULL;
 	ht = new HashTable();
-	trans_ht = new map<int, Transaction>();
+	trans_ht = new unordered_map<int, Transaction>();
+	batch_ht = new unordered_map<int, BatchTransaction>();
 	this->memberNode->addr = *address;
 }
 
@@ -26,6 +38,7 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 MP2Node::~MP2Node() {
 	delete ht;
 	delete trans_ht;
+	delete batch_ht;
 }
 
 /**
@@ -42,11 +55,25 @@ void MP2Node::updateRing() {
 	 * Implement this. Parts of it are already implemented
 	 */
 	vector<Node> curMemList;
-	bool change = false;
+	vector<unsigned long long> curMembers;
 
 	/*
 	 *  Step 1. Get the current membership list from Membership Protocol / MP1
 	 */
+  // Compare packed member addresses first: nodes are only hashed and the ring
+  // rebuilt when membership has actually changed
+  curMembers.reserve(memberNode->memberList.size());
+  for (MemberListEntry & e : memberNode->memberList) {
+    Address addr;
+    memcpy(&addr.addr[0], &e.id, sizeof(int));
+    memcpy(&addr.addr[4], &e.port, sizeof(short));
+    curMembers.emplace_back(addr.pack());
+  }
+  sort(curMembers.begin(), curMembers.end());
+  if (curMembers == ringMembers) {
+    return;
+  }
+  ringMembers = curMembers;
 	curMemList = getMembershipList();
 
 	/*
@@ -54,19 +81,15 @@ void MP2Node::updateRing() {
 	 */
 	// Sort the list based on the hashCode
 	sort(curMemList.begin(), curMemList.end());
-
+  previousRing = ring;
+  ring.build(curMemList, ring.version + 1);
+  rebuildTrees();
 
 	/*
 	 * Step 3: Run the stabilization protocol IF REQUIRED
 	 */
-	// Run stabilization protocol if the hash table size is greater than zero and if there has been a changed in the ring
-  if (curMemList < ring || ring < curMemList || curMemList.size() != ring.size()) {
-    change = true;
-    ring = curMemList;
-  }
-
-  if (change) { stabilizationProtocol(); }
-
+	// Run stabilization protocol since there has been a change in the ring
+  stabilizationProtocol();
 }
 
 /**
@@ -75,9 +98,9 @@ void MP2Node::updateRing() {
  * DESCRIPTION: This function goes through the membership list from the Membership protocol/MP1 and
  * 				i) generates the hash code for each member
  * 				ii) populates the ring member in MP2Node class
- * 				It returns a vector of Nodes. Each element in the vector contain the following fields:
+ * 				It returns a vector of Nodes, par->VNODES per member. Each element in the vector contain the following fields:
  * 				a) Address of the node
- * 				b) Hash code obtained by consistent hashing of the Address
+ * 				b) Hash code obtained by consistent hashing of the Address and virtual node number
  */
 vector<Node> MP2Node::getMembershipList() {
 	unsigned int i;
@@ -88,7 +111,10 @@ vector<Node> MP2Node::getMembershipList() {
 		short port = this->memberNode->memberList.at(i).getport();
 		memcpy(&addressOfThisMember.addr[0], &id, sizeof(int));
 		memcpy(&addressOfThisMember.addr[4], &port, sizeof(short));
-		curMemList.emplace_back(Node(addressOfThisMember));
+		// one ring token per virtual node
+		for ( int v = 0; v < par->VNODES; v++ ) {
+			curMemList.emplace_back(Node(addressOfThisMember, v));
+		}
 	}
 	return curMemList;
 }
@@ -103,9 +129,7 @@ vector<Node> MP2Node::getMembershipList() {
  * size_t position on the ring
  */
 size_t MP2Node::hashFunction(string key) {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret%RING_SIZE;
+	return Partitioner::keyPosition(key);
 }
 
 /**
@@ -117,7 +141,7 @@ size_t MP2Node::hashFunction(string key) {
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientCreate(string key, string value) {
+int MP2Node::clientCreate(string key, string value, ConsistencyLevel level, Completion done) {
 	/*
 	 * Implement this
 	 */
@@ -126,23 +150,36 @@ void MP2Node::clientCreate(string key, string value) {
   int timestamp = par->getcurrtime();
   Address fromAddress = memberNode->addr;
 
-  trans_ht->insert({transID, {0, 0, CREATE, key, value, par->getcurrtime()}});
-
-
   Message primary_msg = Message(transID, fromAddress, CREATE, key, value, PRIMARY);
   Message secondary_msg = Message(transID, fromAddress, CREATE, key, value, SECONDARY);
   Message tertiary_msg = Message(transID, fromAddress, CREATE, key, value, TERTIARY);
+  // the coordinator time versions the value
+  primary_msg.timestamp = secondary_msg.timestamp = tertiary_msg.timestamp = timestamp;
 
   // 2) Finds the replicas of this key
   vector<Node> nodes = findNodes(key);
+  Transaction tran = {0, 0, CREATE, key, value, timestamp, level, (int)nodes.size()};
+  tran.done = done;
 
-  // 3) Sends a message to the replica
+  // 3) Sends a message to the replica, or holds it as a hint while the replica seems down.
+  // A hint does not count toward the consistency level.
   for (unsigned i = 0; i < nodes.size(); i++) {
-    if (i==0) { emulNet->ENsend(&fromAddress, &nodes[0].nodeAddress, primary_msg.toString()); }
-    if (i==1) { emulNet->ENsend(&fromAddress, &nodes[1].nodeAddress, secondary_msg.toString()); }
-    if (i==2) { emulNet->ENsend(&fromAddress, &nodes[2].nodeAddress, tertiary_msg.toString()); }
+    if (isSuspected(nodes[i].nodeAddress)) {
+      storeHint(nodes[i].nodeAddress, {key, value, (int)i, timestamp});
+      tran.failCount++;
+      continue;
+    }
+    if (i==0) { send(&nodes[0].nodeAddress, primary_msg); }
+    if (i==1) { send(&nodes[1].nodeAddress, secondary_msg); }
+    if (i==2) { send(&nodes[2].nodeAddress, tertiary_msg); }
+    tran.unanswered.emplace_back(nodes[i].nodeAddress, i);
   }
-
+  addTransaction(transID, tran);
+  // Fail now if too many replicas got a hint to meet the level
+  settleWrite(transID, trans_ht->at(transID));
+  // The local replica, if this node is one, applies the write right away
+  drainLoopback();
+  return transID;
 }
 
 /**
@@ -154,7 +191,7 @@ void MP2Node::clientCreate(string key, string value) {
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientRead(string key){
+int MP2Node::clientRead(string key, ConsistencyLevel level, Completion done) {
 	/*
 	 * Implement this
 	 */
@@ -162,19 +199,63 @@ void MP2Node::clientRead(string key){
   int transID = ++g_transID;
   Address fromAddress = memberNode->addr;
 
-  trans_ht->insert({transID, {0, 0, READ, key, "", par->getcurrtime()}});
-
   Message msg = Message(transID, fromAddress, READ, key);
+  Message digest_msg = Message(transID, fromAddress, READDIGEST, key);
 
   // 2) Finds the replicas of this key
   vector<Node> nodes = findNodes(key);
+  Transaction tran = {0, 0, READ, key, "", par->getcurrtime(), level, (int)nodes.size()};
+  tran.done = done;
+
+  // Hedged read: ask a quorum of the replicas that seem up, this node first if it is
+  // one of them, and the others only if it is slow
+  if (par->READ_MODE == READ_HEDGED) {
+    int first = requiredAcks(level, nodes.size());
+    stable_partition(nodes.begin(), nodes.end(), [this](Node &node) { return !isSuspected(node.nodeAddress); });
+    stable_partition(nodes.begin(), nodes.end(), [this](Node &node) { return node.nodeAddress == memberNode->addr; });
+    for (unsigned i = first; i < nodes.size(); i++) {
+      tran.standby.push_back(nodes[i].nodeAddress);
+    }
+    nodes.resize(min((size_t)first, nodes.size()));
+    if (!tran.standby.empty()) {
+      read_followups.schedule(transID, par->getcurrtime() + par->HEDGE_DELAY);
+    }
+  }
+  // Digest read: this node returns the value if it is a replica, else the first
+  // replica that seems up; the others return a digest
+  unsigned data = 0;
+  if (par->READ_MODE == READ_DIGEST) {
+    while (data + 1 < nodes.size() && isSuspected(nodes[data].nodeAddress)) {
+      data++;
+    }
+    for (unsigned i = 0; i < nodes.size(); i++) {
+      if (nodes[i].nodeAddress == memberNode->addr) {
+        data = i;
+      }
+    }
+  }
+  for (unsigned i = 0; i < nodes.size(); i++) {
+    bool digest = par->READ_MODE == READ_DIGEST && i != data;
+    tran.unanswered.emplace_back(nodes[i].nodeAddress, digest ? READDIGEST : READ);
+  }
+  addTransaction(transID, tran);
 
   // 3) Sends a message to the replica
-  for (unsigned i = 0; i < nodes.size(); i++) {
-    if (i==0) { emulNet->ENsend(&fromAddress, &nodes[0].nodeAddress, msg.toString()); }
-    if (i==1) { emulNet->ENsend(&fromAddress, &nodes[1].nodeAddress, msg.toString()); }
-    if (i==2) { emulNet->ENsend(&fromAddress, &nodes[2].nodeAddress, msg.toString()); }
+  if (par->READ_MODE != READ_DIGEST) {
+    for (unsigned i = 0; i < nodes.size(); i++) {
+      if (i==0) { send(&nodes[0].nodeAddress, msg); }
+      if (i==1) { send(&nodes[1].nodeAddress, msg); }
+      if (i==2) { send(&nodes[2].nodeAddress, msg); }
+    }
+  } else {
+    for (unsigned i = 0; i < nodes.size(); i++) {
+      send(&nodes[i].nodeAddress, i == data ? msg : digest_msg);
+    }
+    read_followups.schedule(transID, par->getcurrtime() + DIGEST_WAIT);
   }
+  // The local replica, if this node is one, answers right away
+  drainLoopback();
+  return transID;
 }
 
 /**
@@ -186,7 +267,7 @@ void MP2Node::clientRead(string key){
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientUpdate(string key, string value){
+int MP2Node::clientUpdate(string key, string value, ConsistencyLevel level, Completion done) {
 	/*
 	 * Implement this
 	 */
@@ -195,23 +276,36 @@ void MP2Node::clientUpdate(string key, string value){
   int timestamp = par->getcurrtime();
   Address fromAddress = memberNode->addr;
 
-  trans_ht->insert({transID, {0, 0, UPDATE, key, value, par->getcurrtime()}});
-
-
   Message primary_msg = Message(transID, fromAddress, UPDATE, key, value, PRIMARY);
   Message secondary_msg = Message(transID, fromAddress, UPDATE, key, value, SECONDARY);
   Message tertiary_msg = Message(transID, fromAddress, UPDATE, key, value, TERTIARY);
+  // the coordinator time versions the value
+  primary_msg.timestamp = secondary_msg.timestamp = tertiary_msg.timestamp = timestamp;
 
   // 2) Finds the replicas of this key
   vector<Node> nodes = findNodes(key);
+  Transaction tran = {0, 0, UPDATE, key, value, timestamp, level, (int)nodes.size()};
+  tran.done = done;
 
-  // 3) Sends a message to the replica
+  // 3) Sends a message to the replica, or holds it as a hint while the replica seems down.
+  // A hint does not count toward the consistency level.
   for (unsigned i = 0; i < nodes.size(); i++) {
-    if (i==0) { emulNet->ENsend(&fromAddress, &nodes[0].nodeAddress, primary_msg.toString()); }
-    if (i==1) { emulNet->ENsend(&fromAddress, &nodes[1].nodeAddress, secondary_msg.toString()); }
-    if (i==2) { emulNet->ENsend(&fromAddress, &nodes[2].nodeAddress, tertiary_msg.toString()); }
+    if (isSuspected(nodes[i].nodeAddress)) {
+      storeHint(nodes[i].nodeAddress, {key, value, (int)i, timestamp});
+      tran.failCount++;
+      continue;
+    }
+    if (i==0) { send(&nodes[0].nodeAddress, primary_msg); }
+    if (i==1) { send(&nodes[1].nodeAddress, secondary_msg); }
+    if (i==2) { send(&nodes[2].nodeAddress, tertiary_msg); }
+    tran.unanswered.emplace_back(nodes[i].nodeAddress, i);
   }
-
+  addTransaction(transID, tran);
+  // Fail now if too many replicas got a hint to meet the level
+  settleWrite(transID, trans_ht->at(transID));
+  // The local replica, if this node is one, applies the write right away
+  drainLoopback();
+  return transID;
 }
 
 /**
@@ -223,7 +317,7 @@ void MP2Node::clientUpdate(string key, string value){
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientDelete(string key){
+int MP2Node::clientDelete(string key, ConsistencyLevel level, Completion done) {
 	/*
 	 * Implement this
 	 */
@@ -231,18 +325,131 @@ void MP2Node::clientDelete(string key){
   int transID = ++g_transID;
   Address fromAddress = memberNode->addr;
 
-  trans_ht->insert({transID, {0, 0, DELETE, key, "", par->getcurrtime()}});
-
   Message msg = Message(transID, fromAddress, DELETE, key);
 
   // 2) Finds the replicas of this key
   vector<Node> nodes = findNodes(key);
+  Transaction tran = {0, 0, DELETE, key, "", par->getcurrtime(), level, (int)nodes.size()};
+  tran.done = done;
+  for (unsigned i = 0; i < nodes.size(); i++) {
+    tran.unanswered.emplace_back(nodes[i].nodeAddress, i);
+  }
+  addTransaction(transID, tran);
 
   // 3) Sends a message to the replica
   for (unsigned i = 0; i < nodes.size(); i++) {
-	  emulNet->ENsend(&fromAddress, &nodes[i].nodeAddress, msg.toString());
+    send(&nodes[i].nodeAddress, msg);
+  }
+  // The local replica, if this node is one, applies the delete right away
+  drainLoopback();
+  return transID;
+}
+
+/**
+ * FUNCTION NAME: clientMultiGet
+ *
+ * DESCRIPTION: client side multi-key READ API. Every key is read with its own
+ * 				quorum, but each replica gets the keys it holds in one message.
+ */
+int MP2Node::clientMultiGet(vector<string> keys, ConsistencyLevel level, Completion done) {
+  vector<pair<string, string>> kvs;
+  kvs.reserve(keys.size());
+  for (string &key : keys) {
+    kvs.emplace_back(key, "");
+  }
+  return startBatch(READ, kvs, level, done);
+}
+
+/**
+ * FUNCTION NAME: clientMultiPut
+ *
+ * DESCRIPTION: client side multi-key CREATE API, batched per replica like clientMultiGet
+ */
+int MP2Node::clientMultiPut(vector<pair<string, string>> kvs, ConsistencyLevel level, Completion done) {
+  return startBatch(CREATE, kvs, level, done);
+}
+
+/**
+ * FUNCTION NAME: startBatch
+ *
+ * DESCRIPTION: Open one parent transaction for all the keys, group the keys by
+ * 				replica and send every replica its share of the batch
+ */
+int MP2Node::startBatch(MessageType type, const vector<pair<string, string>> &kvs, ConsistencyLevel level, Completion done) {
+  int transID = ++g_transID;
+  BatchTransaction batch;
+  // packed replica address -> the replica and the keys it holds
+  map<unsigned long long, pair<Address, vector<BatchEntry>>> perReplica;
+  vector<string> unreachable;
+
+  batch.messageType = type;
+  for (auto const & [key, value] : kvs) {
+    if (batch.keys.count(key)) {
+      continue;
+    }
+    vector<Node> nodes = findNodes(key);
+    Transaction &tran = batch.keys[key] = {0, 0, type, key, value, par->getcurrtime(), level, (int)nodes.size()};
+    tran.done = done;
+    for (unsigned i = 0; i < nodes.size(); i++) {
+      if (type == CREATE && isSuspected(nodes[i].nodeAddress)) {
+        storeHint(nodes[i].nodeAddress, {key, value, (int)i, par->getcurrtime()});
+        tran.failCount++;
+        continue;
+      }
+      pair<Address, vector<BatchEntry>> &replica = perReplica[nodes[i].nodeAddress.pack()];
+      replica.first = nodes[i].nodeAddress;
+      replica.second.push_back({key, value, (int)i, par->getcurrtime()});
+    }
+    if (tran.failCount > tran.replicas - requiredAcks(level, tran.replicas)) {
+      unreachable.push_back(key);
+    }
+  }
+  // Keys with too many replicas hinted to meet the level fail now
+  for (const string &key : unreachable) {
+    completeRequest(transID, batch.keys[key], false);
+    batch.keys.erase(key);
+  }
+  batch_ht->insert({transID, std::move(batch)});
+  trans_timeouts.schedule(transID, par->getcurrtime() + TIMEOUT + 1);
+
+  for (auto & [packed, replica] : perReplica) {
+    sendBatch(&replica.first, transID, (type == READ) ? MULTIGET : MULTIPUT, replica.second);
   }
+  drainLoopback();
+  return transID;
+}
 
+/**
+ * FUNCTION NAME: sendBatch
+ *
+ * DESCRIPTION: Send entries to one node, split into as few messages as fit under
+ * 				the maximum message size of the network
+ *
+ * RETURNS:
+ * bytes sent
+ */
+size_t MP2Node::sendBatch(Address *toAddr, int transID, MessageType type, const vector<BatchEntry> &entries) {
+  size_t budget = par->MAX_MSG_SIZE - sizeof(en_msg) - BATCH_HEADER_MAX - 1;
+  vector<BatchEntry> chunk;
+  size_t size = 0;
+  size_t sent = 0;
+
+  for (const BatchEntry &entry : entries) {
+    size_t entrySize = Message::entryWireSize(entry);
+    if (!chunk.empty() && size + entrySize > budget) {
+      Message msg = Message(transID, memberNode->addr, type, chunk);
+      sent += send(toAddr, msg);
+      chunk.clear();
+      size = 0;
+    }
+    chunk.push_back(entry);
+    size += entrySize;
+  }
+  if (!chunk.empty()) {
+    Message msg = Message(transID, memberNode->addr, type, chunk);
+    sent += send(toAddr, msg);
+  }
+  return sent;
 }
 
 /**
@@ -253,12 +460,21 @@ void MP2Node::clientDelete(string key){
  * 			   	1) Inserts key value into the local hash table
  * 			   	2) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
+bool MP2Node::createKeyValue(string key, string value, ReplicaType replica, int timestamp) {
 	/*
 	 * Implement this
 	 */
-	// Insert key, value, replicaType into the hash table
-  ht->create(key, value);
+	// Insert key, value, replicaType into the hash table, unless it holds a newer version
+  Entry entry(value, timestamp, replica);
+  string stored = ht->read(key);
+  if (stored.empty()) {
+    ht->create(key, entry.convertToString());
+    toggleTree(key, entry.convertToString());
+  } else if (entry.isNewerThan(Entry(stored))) {
+    ht->update(key, entry.convertToString());
+    toggleTree(key, stored);
+    toggleTree(key, entry.convertToString());
+  }
   return ht->count(key) > 0;
 }
 
@@ -270,12 +486,20 @@ bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
  * 			    1) Read key from local hash table
  * 			    2) Return value
  */
-string MP2Node::readKey(string key) {
+string MP2Node::readKey(string key, int *timestamp) {
 	/*
 	 * Implement this
 	 */
 	// Read key from local hash table and return value
-  return ht->read(key);
+  string stored = ht->read(key);
+  if (stored.empty()) {
+    return "";
+  }
+  Entry entry(stored);
+  if (timestamp != NULL) {
+    *timestamp = entry.timestamp;
+  }
+  return entry.value;
 }
 
 /**
@@ -285,12 +509,23 @@ string MP2Node::readKey(string key) {
  * 				1) Update the key to the new value in the local hash table
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica) {
+bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica, int timestamp) {
 	/*
 	 * Implement this
 	 */
-	// Update key in local hash table and return true or false
-  return ht->update(key, value);
+	// Update key in local hash table and return true or false; an older version
+	// than the stored one is ignored but still succeeds
+  string stored = ht->read(key);
+  if (stored.empty()) {
+    return false;
+  }
+  Entry entry(value, timestamp, replica);
+  if (entry.isNewerThan(Entry(stored))) {
+    ht->update(key, entry.convertToString());
+    toggleTree(key, stored);
+    toggleTree(key, entry.convertToString());
+  }
+  return true;
 }
 
 /**
@@ -306,7 +541,12 @@ bool MP2Node::deletekey(string key) {
 	 * Implement this
 	 */
 	// Delete the key from the local hash table
-  return ht->deleteKey(key);
+  string old = ht->read(key);
+  if (!ht->deleteKey(key)) {
+    return false;
+  }
+  toggleTree(key, old);
+  return true;
 }
 
 /**
@@ -328,6 +568,9 @@ void MP2Node::checkMessages() {
 	 * Declare your local variables here
 	 */
 
+	vector<pair<char *, int>> received;
+	vector<Message> requests;
+
 	// dequeue all messages and handle them
 	while ( !memberNode->mp2q.empty() ) {
 		/*
@@ -336,42 +579,55 @@ void MP2Node::checkMessages() {
 		data = (char *)memberNode->mp2q.front().elt;
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
-
-		string message(data, data + size);
-
-		/*
-		 * Handle the messagtypes here */
-    Message msg = Message(message);
-   
-    // CREATE, READ, UPDATE, DELETE, REPLY, READREPLY
-    switch (msg.type) {
-      case CREATE: handleCreateMsg(msg); break;
-      case READ: handleReadMsg(msg); break;
-      case UPDATE: handleUpdateMsg(msg); break;
-      case DELETE: handleDeleteMsg(msg); break;
-      case REPLY: handleReplyMsg(msg); break;
-      case READREPLY: handleReadReplyMsg(msg); break;
-    } 
-
+		received.push_back({data, size});
 	}
-  
-  // Handle timeout
-  map<int, Transaction>& htt = *trans_ht;
-  vector<int> timeoutedTrans;
-  for (auto const & [transID, tran] : htt) {
-    if (tran.timestamp+TIMEOUT< par->getcurrtime()) {
-      switch (tran.messageType) {
-        case CREATE: log->logCreateFail(&memberNode->addr, true, transID, tran.key, tran.value); break; 
-        case READ: log->logReadFail(&memberNode->addr, true, transID, tran.key); break; 
-        case UPDATE: log->logUpdateFail(&memberNode->addr, true, transID, tran.key, tran.value); break; 
-        case DELETE: log->logDeleteFail(&memberNode->addr, true, transID, tran.key); break; 
+
+  // Cancel hints ride on requests; decode those first so that READs queued behind a
+  // hint for their transaction are skipped
+  for (auto & [data, size] : received) {
+    MessageType type;
+    int transID;
+    if (Message::peekHeader(data, size, &type, &transID) && Message::isRequest(type)) {
+      requests.emplace_back(data, size);
+      if (requests.back().valid) {
+        noteCancelled(requests.back());
       }
-      timeoutedTrans.emplace_back(transID);
     }
   }
-  for (unsigned int i=0; i<timeoutedTrans.size(); i++) {
-    trans_ht->erase((int)timeoutedTrans[i]);
+
+	/*
+	 * Handle the messagtypes here */
+  size_t next = 0;
+  for (auto & [data, size] : received) {
+    // Replies to transactions finished by an earlier message are dropped without decoding them
+    if (isLateReply(data, size)) {
+      emulNet->ENfree(data);
+      continue;
+    }
+    MessageType type;
+    int transID;
+    bool request = Message::peekHeader(data, size, &type, &transID) && Message::isRequest(type);
+    // Decode straight from the pooled buffer, then hand the buffer back to EmulNet
+    Message msg = request ? std::move(requests[next++]) : Message(data, size);
+    emulNet->ENfree(data);
+    // A truncated message is dropped rather than handled half filled
+    if (!msg.valid || isCancelled(msg)) {
+      continue;
+    }
+    handleMessage(msg);
+    // Messages this node sent itself are handled before the next one
+    drainLoopback();
   }
+  
+  // Handle timeout
+  expireTransactions();
+  // Hedge or fetch the value for reads whose replicas are slow
+  followUpReads();
+  // Ask again the replicas that have not answered
+  retryRequests();
+  // Hand held writes to replicas that are back
+  replayHints();
+  drainLoopback();
 
 
 	/*
@@ -380,17 +636,516 @@ void MP2Node::checkMessages() {
 	 */
 }
 
-void MP2Node::handleReplyMsg(Message msg) {
+/**
+ * FUNCTION NAME: handleMessage
+ *
+ * DESCRIPTION: Call the handler of the message type
+ */
+void MP2Node::handleMessage(Message &msg) {
+  // CREATE, READ, UPDATE, DELETE, REPLY, READREPLY
+  switch (msg.type) {
+    case CREATE: handleCreateMsg(msg); break;
+    case READ: handleReadMsg(msg); break;
+    case UPDATE: handleUpdateMsg(msg); break;
+    case DELETE: handleDeleteMsg(msg); break;
+    case REPLY: handleReplyMsg(msg); break;
+    case READREPLY: handleReadReplyMsg(msg); break;
+    case MULTIGET: handleMultiGetMsg(msg); break;
+    case MULTIPUT: handleMultiPutMsg(msg); break;
+    case MULTIREPLY: handleMultiReplyMsg(msg); break;
+    case MERKLEDIGEST: handleMerkleDigestMsg(msg); break;
+    case STREAM: handleStreamMsg(msg); break;
+    case STREAMACK: handleStreamAckMsg(msg); break;
+    case HINT: handleHintMsg(msg); break;
+    case HINTACK: handleHintAckMsg(msg); break;
+    case READDIGEST: handleReadDigestMsg(msg); break;
+    case DIGESTREPLY: handleDigestReplyMsg(msg); break;
+  }
+}
 
-	if (msg.transID == -1 || !trans_ht->count(msg.transID)) {
-    if (msg.transID != -1 && !trans_ht->count(msg.transID)) {
-      std::cout << "READ timeout: " << msg.transID << std::endl;
+/**
+ * FUNCTION NAME: send
+ *
+ * DESCRIPTION: Send a message to a node. A message to this node itself skips
+ * 				EmulNet: it is queued and handled as soon as the client call or
+ * 				message handler sending it returns.
+ *
+ * RETURNS:
+ * bytes put on the network
+ */
+size_t MP2Node::send(Address *toAddr, Message &msg) {
+  if (*toAddr == memberNode->addr) {
+    loopback.push(msg);
+    return 0;
+  }
+  // Piggyback the READs this replica need not answer any more on the next request to it
+  unordered_map<unsigned long long, vector<int>>::iterator hints = cancelHints.end();
+  if (Message::isRequest(msg.type)) {
+    hints = cancelHints.find(toAddr->pack());
+  }
+  if (hints != cancelHints.end()) {
+    msg.cancelled.swap(hints->second);
+    cancelHints.erase(hints);
+  }
+  string data = msg.encode();
+  msg.cancelled.clear();
+  emulNet->ENsend(&memberNode->addr, toAddr, data);
+  return data.size();
+}
+
+/**
+ * FUNCTION NAME: isLateReply
+ *
+ * DESCRIPTION: Whether a received buffer is a reply to a transaction that has already
+ * 				finished and has no read repair pending, judged from its header alone
+ */
+bool MP2Node::isLateReply(const char *data, int size) {
+  MessageType type;
+  int transID;
+  if (!Message::peekHeader(data, size, &type, &transID)) {
+    return false;
+  }
+  if (type != REPLY && type != READREPLY && type != DIGESTREPLY) {
+    return false;
+  }
+  return completed.contains(transID) && (type == REPLY || !repairs.count(transID));
+}
+
+/**
+ * FUNCTION NAME: noteCancelled
+ *
+ * DESCRIPTION: Remember the READs a coordinator has cancelled, evicting the oldest
+ */
+void MP2Node::noteCancelled(Message &msg) {
+  for (int transID : msg.cancelled) {
+    pair<unsigned long long, int> id = {msg.fromAddr.pack(), transID};
+    if (cancelledReads.insert(id).second) {
+      cancelledOrder.push(id);
     }
-		// Key not found
+    if (cancelledOrder.size() > CANCEL_CACHE_SIZE) {
+      cancelledReads.erase(cancelledOrder.front());
+      cancelledOrder.pop();
+    }
+  }
+}
+
+/**
+ * FUNCTION NAME: isCancelled
+ *
+ * DESCRIPTION: Whether a READ belongs to a transaction its coordinator has finished.
+ * 				Writes are always applied, so that every replica keeps the value.
+ */
+bool MP2Node::isCancelled(Message &msg) {
+  if (msg.type != READ && msg.type != READDIGEST) {
+    return false;
+  }
+  return cancelledReads.count({msg.fromAddr.pack(), msg.transID}) > 0;
+}
+
+/**
+ * FUNCTION NAME: drainLoopback
+ *
+ * DESCRIPTION: Handle the messages this node sent itself, including those their
+ * 				handlers send in turn, then run the completion callbacks of the
+ * 				requests that finished. Callbacks may start new requests.
+ */
+void MP2Node::drainLoopback() {
+  while (!loopback.empty() || !completions.empty()) {
+    if (!loopback.empty()) {
+      Message msg = loopback.front();
+      loopback.pop();
+      handleMessage(msg);
+      continue;
+    }
+    pair<Completion, RequestResult> completion = completions.front();
+    completions.pop();
+    completion.first(completion.second);
+  }
+}
+
+/**
+ * FUNCTION NAME: addTransaction
+ *
+ * DESCRIPTION: Start tracking a coordinator transaction and schedule its timeout
+ */
+void MP2Node::addTransaction(int transID, Transaction tran) {
+  trans_ht->insert({transID, tran});
+  trans_timeouts.schedule(transID, tran.timestamp + TIMEOUT + 1);
+  retry_timers.schedule(transID, tran.timestamp + RETRY_TIMEOUT);
+}
+
+/**
+ * FUNCTION NAME: retryRequests
+ *
+ * DESCRIPTION: Ask the replicas that have not answered an open transaction again, with
+ * 				the same transID so that they can recognise a retry. The wait doubles
+ * 				after every retry until the transaction times out.
+ */
+void MP2Node::retryRequests() {
+  vector<int> due;
+  retry_timers.advance(par->getcurrtime(), due);
+  for (int transID : due) {
+    unordered_map<int, Transaction>::iterator it = trans_ht->find(transID);
+    if (it == trans_ht->end()) {
+      continue;
+    }
+    Transaction &tran = it->second;
+    for (auto & [replica, type] : tran.unanswered) {
+      if (!isSuspected(replica)) {
+        Message msg = requestFor(transID, tran, type);
+        send(&replica, msg);
+      }
+    }
+    tran.retries++;
+    int next = par->getcurrtime() + (RETRY_TIMEOUT << tran.retries);
+    if (next <= tran.timestamp + TIMEOUT) {
+      retry_timers.schedule(transID, next);
+    }
+  }
+}
+
+/**
+ * FUNCTION NAME: requestFor
+ *
+ * DESCRIPTION: Rebuild the request of a transaction for one of its replicas. kind is the
+ * 				ReplicaType of a write, or whether a read asked for the value (READ) or
+ * 				its digest (READDIGEST). The version of a write is the time of the request.
+ */
+Message MP2Node::requestFor(int transID, Transaction &tran, int kind) {
+  if (tran.messageType == CREATE || tran.messageType == UPDATE) {
+    Message msg = Message(transID, memberNode->addr, tran.messageType, tran.key, tran.value, (ReplicaType)kind);
+    msg.timestamp = tran.timestamp;
+    return msg;
+  }
+  if (tran.messageType == READ) {
+    return Message(transID, memberNode->addr, (MessageType)kind, tran.key);
+  }
+  return Message(transID, memberNode->addr, tran.messageType, tran.key);
+}
+
+/**
+ * FUNCTION NAME: markAnswered
+ *
+ * DESCRIPTION: Stop retrying a transaction to a replica that answered it
+ */
+void MP2Node::markAnswered(Transaction &tran, Address &replica) {
+  for (unsigned i = 0; i < tran.unanswered.size(); i++) {
+    if (tran.unanswered[i].first == replica) {
+      tran.unanswered.erase(tran.unanswered.begin() + i);
+      return;
+    }
+  }
+}
+
+/**
+ * FUNCTION NAME: isDuplicate
+ *
+ * DESCRIPTION: Whether a write is a retry of one already applied here, and its outcome
+ */
+bool MP2Node::isDuplicate(Message &msg, bool *success) {
+  map<pair<unsigned long long, int>, bool>::iterator it = applied.find({msg.fromAddr.pack(), msg.transID});
+  if (msg.transID == -1 || it == applied.end()) {
+    return false;
+  }
+  *success = it->second;
+  return true;
+}
+
+/**
+ * FUNCTION NAME: rememberWrite
+ *
+ * DESCRIPTION: Record the outcome of a write to answer its retries, evicting the oldest
+ */
+void MP2Node::rememberWrite(Message &msg, bool success) {
+  if (msg.transID == -1) {
+    return;
+  }
+  pair<unsigned long long, int> id = {msg.fromAddr.pack(), msg.transID};
+  if (applied.insert({id, success}).second) {
+    appliedOrder.push(id);
+  }
+  if (appliedOrder.size() > DEDUP_CACHE_SIZE) {
+    applied.erase(appliedOrder.front());
+    appliedOrder.pop();
+  }
+}
+
+/**
+ * FUNCTION NAME: requiredAcks
+ *
+ * DESCRIPTION: Number of acks a request sent to replicas replicas needs at level
+ */
+int MP2Node::requiredAcks(ConsistencyLevel level, int replicas) {
+  switch (level) {
+    case ONE: return 1;
+    case ALL: return replicas;
+    default: return replicas / 2 + 1;
+  }
+}
+
+/**
+ * FUNCTION NAME: completeRequest
+ *
+ * DESCRIPTION: Log the coordinator outcome of the request for one key and record
+ * 				its latency
+ */
+void MP2Node::completeRequest(int transID, Transaction &tran, bool success) {
+  LatencyStats &stats = latency[tran.level];
+
+  stats.requests++;
+  if (success) {
+    stats.ticks[par->getcurrtime() - tran.timestamp]++;
+    switch (tran.messageType) {
+      case CREATE: log->logCreateSuccess(&memberNode->addr, true, transID, tran.key, tran.value); break; 
+      case READ: log->logReadSuccess(&memberNode->addr, true, transID, tran.key, tran.value); break; 
+      case UPDATE: log->logUpdateSuccess(&memberNode->addr, true, transID, tran.key, tran.value); break; 
+      case DELETE: log->logDeleteSuccess(&memberNode->addr, true, transID, tran.key); break; 
+      default: break;
+    }
+  } else {
+    stats.failed++;
+    switch (tran.messageType) {
+      case CREATE: log->logCreateFail(&memberNode->addr, true, transID, tran.key, tran.value); break; 
+      case READ: log->logReadFail(&memberNode->addr, true, transID, tran.key); break; 
+      case UPDATE: log->logUpdateFail(&memberNode->addr, true, transID, tran.key, tran.value); break; 
+      case DELETE: log->logDeleteFail(&memberNode->addr, true, transID, tran.key); break; 
+      default: break;
+    }
+  }
+  if (tran.done) {
+    string value = (success || tran.messageType != READ) ? tran.value : "";
+    completions.push({tran.done, {transID, tran.messageType, tran.key, value, success, par->getcurrtime() - tran.timestamp}});
+  }
+}
+
+/**
+ * FUNCTION NAME: settleRead
+ *
+ * DESCRIPTION: Complete a READ once the consistency level is met, or can no longer be met
+ */
+void MP2Node::settleRead(int transID, Transaction &tran) {
+  int required = requiredAcks(tran.level, tran.replicas);
+
+  if (tran.successCount >= required) {
+    readRepair(transID, tran);
+    finishTransaction(transID, true);
+  } else if (tran.failCount > tran.replicas - required || tran.timestamp+TIMEOUT< par->getcurrtime()) {
+    finishTransaction(transID, false);
+  }
+}
+
+/**
+ * FUNCTION NAME: resolveDigests
+ *
+ * DESCRIPTION: Compare the digests a READ has received to the value read so far. A
+ * 				digest of the same or an older version counts as that replica's answer;
+ * 				a replica that may hold a newer version is asked for its full value.
+ * 				Once the value is overdue, every digest replica is asked for it instead.
+ * 				A replica asked for its value is retried like any unanswered one.
+ */
+void MP2Node::resolveDigests(int transID, Transaction &tran) {
+  Message fetch = Message(transID, memberNode->addr, READ, tran.key);
+
+  if (!tran.hasData) {
+    if (par->getcurrtime() < tran.timestamp + DIGEST_WAIT) {
+      return;
+    }
+    for (DigestAnswer &answer : tran.digests) {
+      send(&answer.replica, fetch);
+      tran.unanswered.emplace_back(answer.replica, READ);
+    }
+    tran.digests.clear();
+    return;
+  }
+  unsigned long long current = valueDigest(tran.value, tran.version);
+
+  for (DigestAnswer &answer : tran.digests) {
+    if (answer.digest == current) {
+      tran.answers.emplace_back(answer.replica, Entry(tran.value, tran.value.empty() ? -1 : tran.version, PRIMARY));
+      if (tran.value.empty()) {
+        tran.failCount++;
+      } else {
+        tran.successCount++;
+      }
+    } else if (answer.digest == 0) {
+      tran.answers.emplace_back(answer.replica, Entry("", -1, PRIMARY));
+      tran.failCount++;
+    } else if (!tran.value.empty() && answer.timestamp < tran.version) {
+      // Only the version is known; it is enough to repair the replica
+      tran.answers.emplace_back(answer.replica, Entry("", answer.timestamp, PRIMARY));
+      tran.successCount++;
+    } else {
+      send(&answer.replica, fetch);
+      tran.unanswered.emplace_back(answer.replica, READ);
+    }
+  }
+  tran.digests.clear();
+}
+
+/**
+ * FUNCTION NAME: followUpReads
+ *
+ * DESCRIPTION: Follow up on the READs whose replicas have not answered in time, e.g.
+ * 				because a replica failed: hedged READs ask the replicas they left out,
+ * 				digest READs still without a value fetch it from the digest replicas
+ */
+void MP2Node::followUpReads() {
+  vector<int> due;
+  read_followups.advance(par->getcurrtime(), due);
+  for (int transID : due) {
+    unordered_map<int, Transaction>::iterator it = trans_ht->find(transID);
+    if (it == trans_ht->end()) {
+      continue;
+    }
+    hedgeRead(transID, it->second);
+    if (!it->second.hasData) {
+      resolveDigests(transID, it->second);
+    }
+  }
+}
+
+/**
+ * FUNCTION NAME: hedgeRead
+ *
+ * DESCRIPTION: Ask the replicas a hedged READ left out
+ */
+void MP2Node::hedgeRead(int transID, Transaction &tran) {
+  Message msg = Message(transID, memberNode->addr, READ, tran.key);
+  for (Address &replica : tran.standby) {
+    send(&replica, msg);
+    tran.unanswered.emplace_back(replica, READ);
+  }
+  tran.standby.clear();
+}
+
+/**
+ * FUNCTION NAME: valueDigest
+ *
+ * DESCRIPTION: Digest of a version of a value, 0 for no value
+ */
+unsigned long long MP2Node::valueDigest(const string &value, int timestamp) {
+  if (value.empty()) {
+    return 0;
+  }
+  unsigned long long digest = Partitioner::xxh64(value.data(), value.size(), timestamp);
+  return digest == 0 ? 1 : digest;
+}
+
+/**
+ * FUNCTION NAME: readRepair
+ *
+ * DESCRIPTION: Push the newest version a READ found to every replica that answered
+ * 				with an older one, and remember it for the replicas that have not
+ * 				answered yet. A replica without the key is left alone: without
+ * 				tombstones it may as well have applied a later DELETE, which the
+ * 				repair would undo.
+ */
+void MP2Node::readRepair(int transID, Transaction &tran) {
+  BatchEntry newest = {tran.key, tran.value, PRIMARY, tran.version};
+  Entry version(tran.value, tran.version, PRIMARY);
+
+  for (auto & [replica, answer] : tran.answers) {
+    if (answer.timestamp != -1 && version.isNewerThan(answer)) {
+      repairReplica(replica, newest);
+    }
+  }
+  if ((int)tran.answers.size() < tran.replicas) {
+    repairs.insert({transID, newest});
+  }
+}
+
+/**
+ * FUNCTION NAME: repairReplica
+ *
+ * DESCRIPTION: Send the newest version of a key to a stale replica, without waiting for an ack
+ */
+void MP2Node::repairReplica(Address &replica, const BatchEntry &newest) {
+  BatchEntry repair = newest;
+  vector<Node> nodes = findNodes(newest.key);
+  for (unsigned i = 0; i < nodes.size(); i++) {
+    if (nodes[i].nodeAddress == replica) {
+      repair.flag = i;
+    }
+  }
+  sendBatch(&replica, -1, HINT, vector<BatchEntry>(1, repair));
+}
+
+/**
+ * FUNCTION NAME: finishTransaction
+ *
+ * DESCRIPTION: Complete a single key transaction and stop tracking it
+ */
+void MP2Node::finishTransaction(int transID, bool success) {
+  unordered_map<int, Transaction>::iterator it = trans_ht->find(transID);
+  Transaction &tran = it->second;
+  completeRequest(transID, tran, success);
+  completed.insert(transID);
+  // Replicas yet to answer a READ are told to skip it
+  if (tran.messageType == READ) {
+    for (auto & [replica, type] : tran.unanswered) {
+      if (replica == memberNode->addr) {
+        continue;
+      }
+      vector<int> &held = cancelHints[replica.pack()];
+      held.push_back(transID);
+      if (held.size() > CANCEL_HINTS_MAX) {
+        held.erase(held.begin());
+      }
+    }
+  }
+  trans_ht->erase(it);
+}
+
+/**
+ * FUNCTION NAME: expireTransactions
+ *
+ * DESCRIPTION: Fail the transactions whose timeout is due. Only the timers due this
+ * 				tick are visited; timers of transactions already finished are dropped.
+ */
+void MP2Node::expireTransactions() {
+  vector<int> due;
+  trans_timeouts.advance(par->getcurrtime(), due);
+  for (int transID : due) {
+    if (trans_ht->count(transID)) {
+      finishTransaction(transID, false);
+      continue;
+    }
+    if (repairs.erase(transID)) {
+      continue;
+    }
+    // Keys of a batch still open at the timeout all fail
+    unordered_map<int, BatchTransaction>::iterator it = batch_ht->find(transID);
+    if (it != batch_ht->end()) {
+      for (auto & [key, tran] : it->second.keys) {
+        completeRequest(transID, tran, false);
+      }
+      batch_ht->erase(it);
+      continue;
+    }
+    // Keys of a handoff never acknowledged are kept
+    if (handoffs.erase(transID)) {
+      continue;
+    }
+    // Hints of a replay never acknowledged are held again, unless a newer write replaced them
+    unordered_map<int, HintedWrites>::iterator replay = replays.find(transID);
+    if (replay != replays.end()) {
+      HintedWrites &held = hints[replay->second.target.pack()];
+      held.target = replay->second.target;
+      held.writes.insert(replay->second.writes.begin(), replay->second.writes.end());
+      replays.erase(replay);
+    }
+  }
+}
+
+void MP2Node::handleReplyMsg(Message &msg) {
+
+	if (msg.transID == -1 || !trans_ht->count(msg.transID)) {
+		// Late reply to a finished transaction
 		return;
 	}
 
-  Transaction tran = trans_ht->at(msg.transID);
+  Transaction &tran = trans_ht->at(msg.transID);
+  markAnswered(tran, msg.fromAddr);
 
   if (msg.success) {
     tran.successCount++;
@@ -398,58 +1153,97 @@ void MP2Node::handleReplyMsg(Message msg) {
     tran.failCount++;
   }
 
-  trans_ht->at(msg.transID) = tran;
+  settleWrite(msg.transID, tran);
+  return;
+}
 
-  if (tran.successCount > 1) {
-    switch (tran.messageType) {
-      case CREATE: log->logCreateSuccess(&memberNode->addr, true, msg.transID, tran.key, tran.value); break; 
-      case UPDATE: log->logUpdateSuccess(&memberNode->addr, true, msg.transID, tran.key, tran.value); break; 
-      case DELETE: log->logDeleteSuccess(&memberNode->addr, true, msg.transID, tran.key); break; 
-    }
-    trans_ht->erase(msg.transID);
-  } 
+/**
+ * FUNCTION NAME: settleWrite
+ *
+ * DESCRIPTION: Complete a write as soon as the consistency level is met, or can no
+ * 				longer be met
+ */
+void MP2Node::settleWrite(int transID, Transaction &tran) {
+  int required = requiredAcks(tran.level, tran.replicas);
 
-  if (tran.failCount > 1 || tran.timestamp+TIMEOUT< par->getcurrtime()) {
-    switch (tran.messageType) {
-      case CREATE: log->logCreateFail(&memberNode->addr, true, msg.transID, tran.key, tran.value); break; 
-      case UPDATE: log->logUpdateFail(&memberNode->addr, true, msg.transID, tran.key, tran.value); break; 
-      case DELETE: log->logDeleteFail(&memberNode->addr, true, msg.transID, tran.key); break; 
-    }
-    trans_ht->erase(msg.transID);
+  if (tran.successCount >= required) {
+    finishTransaction(transID, true);
+  } else if (tran.failCount > tran.replicas - required || tran.timestamp+TIMEOUT< par->getcurrtime()) {
+    finishTransaction(transID, false);
   }
-
-  return;
 }
 
-void MP2Node::handleReadReplyMsg(Message msg) {
+void MP2Node::handleReadReplyMsg(Message &msg) {
 	if (msg.transID == -1 || !trans_ht->count(msg.transID)) {
+    // A replica answering with an older version after the read completed is still repaired
+    unordered_map<int, BatchEntry>::iterator it = repairs.find(msg.transID);
+    if (it != repairs.end()) {
+      Entry newest(it->second.value, it->second.timestamp, PRIMARY);
+      if (!msg.value.empty() && newest.isNewerThan(Entry(msg.value, msg.timestamp, PRIMARY))) {
+        repairReplica(msg.fromAddr, it->second);
+      }
+    }
 		// Key not found
 		return;
 	}
 
-  Transaction tran = trans_ht->at(msg.transID);
+  Transaction &tran = trans_ht->at(msg.transID);
+  markAnswered(tran, msg.fromAddr);
 
+  // An empty answer is the oldest version there is, but is never repaired
+  Entry answer(msg.value, msg.value.empty() ? -1 : msg.timestamp, PRIMARY);
+  tran.answers.emplace_back(msg.fromAddr, answer);
   if (msg.value.empty()) {
     tran.failCount++;
   } else {
+    // Keep the newest version among the replies
+    if (tran.successCount == 0 || answer.isNewerThan(Entry(tran.value, tran.version, PRIMARY))) {
+      tran.value = msg.value;
+      tran.version = msg.timestamp;
+    }
     tran.successCount++;
   }
-  tran.value = msg.value;
-  trans_ht->at(msg.transID) = tran;
-
-  if (tran.successCount > 1) {
-    log->logReadSuccess(&memberNode->addr, true, msg.transID, tran.key, tran.value);
-    trans_ht->erase(msg.transID);
-  } 
-  if (tran.failCount > 1 || tran.timestamp+TIMEOUT< par->getcurrtime()) {
-    log->logReadFail(&memberNode->addr, true, msg.transID, tran.key);
-    trans_ht->erase(msg.transID);
+  tran.hasData = true;
+  resolveDigests(msg.transID, tran);
+  // A replica without the key cannot make up the quorum, so hedge now
+  if (msg.value.empty()) {
+    hedgeRead(msg.transID, tran);
   }
+
+  settleRead(msg.transID, tran);
+}
+
+void MP2Node::handleDigestReplyMsg(Message &msg) {
+  unsigned long long digest = msg.digest.empty() ? 0 : msg.digest[0];
+
+	if (msg.transID == -1 || !trans_ht->count(msg.transID)) {
+    // A replica answering after the read completed is repaired if it holds an older version
+    unordered_map<int, BatchEntry>::iterator it = repairs.find(msg.transID);
+    if (it != repairs.end() && digest != 0 && digest != valueDigest(it->second.value, it->second.timestamp)
+        && msg.timestamp < it->second.timestamp) {
+      repairReplica(msg.fromAddr, it->second);
+    }
+		return;
+	}
+
+  Transaction &tran = trans_ht->at(msg.transID);
+  markAnswered(tran, msg.fromAddr);
+  tran.digests.push_back({msg.fromAddr, digest, msg.timestamp});
+  resolveDigests(msg.transID, tran);
+
+  settleRead(msg.transID, tran);
 }
 
 
-void MP2Node::handleCreateMsg(Message msg) {
-  bool isCreated = createKeyValue(msg.key, msg.value, msg.replica);
+void MP2Node::handleCreateMsg(Message &msg) {
+  bool isCreated;
+  if (isDuplicate(msg, &isCreated)) {
+    Message reply = Message(msg.transID, memberNode->addr, REPLY, isCreated);
+    send(&msg.fromAddr, reply);
+    return;
+  }
+  isCreated = createKeyValue(msg.key, msg.value, msg.replica, msg.timestamp);
+  rememberWrite(msg, isCreated);
 
   if (msg.transID != -1) { 
     if (isCreated) {
@@ -460,11 +1254,12 @@ void MP2Node::handleCreateMsg(Message msg) {
   }
 
   Message reply = Message(msg.transID, memberNode->addr, REPLY, isCreated); 
-	emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+  send(&msg.fromAddr, reply);
 }
 
-void MP2Node::handleReadMsg(Message msg) {
-  string value = readKey(msg.key);
+void MP2Node::handleReadMsg(Message &msg) {
+  int timestamp = 0;
+  string value = readKey(msg.key, &timestamp);
 
   if (msg.transID != -1) { 
     if (value.empty()) {
@@ -475,11 +1270,35 @@ void MP2Node::handleReadMsg(Message msg) {
   }
 
   Message reply = Message(msg.transID, memberNode->addr, value); 
-	emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+  reply.timestamp = timestamp;
+  send(&msg.fromAddr, reply);
+}
+
+void MP2Node::handleReadDigestMsg(Message &msg) {
+  int timestamp = 0;
+  string value = readKey(msg.key, &timestamp);
+
+  if (msg.transID != -1) { 
+    if (value.empty()) {
+      log->logReadFail(&memberNode->addr, false, msg.transID, msg.key);
+    } else {
+      log->logReadSuccess(&memberNode->addr, false, msg.transID, msg.key, value);
+    }
+  }
+
+  Message reply = Message(msg.transID, memberNode->addr, valueDigest(value, timestamp), timestamp); 
+  send(&msg.fromAddr, reply);
 }
 
-void MP2Node::handleUpdateMsg(Message msg) {
-  bool isUpdated = updateKeyValue(msg.key, msg.value, msg.replica);
+void MP2Node::handleUpdateMsg(Message &msg) {
+  bool isUpdated;
+  if (isDuplicate(msg, &isUpdated)) {
+    Message reply = Message(msg.transID, memberNode->addr, REPLY, isUpdated);
+    send(&msg.fromAddr, reply);
+    return;
+  }
+  isUpdated = updateKeyValue(msg.key, msg.value, msg.replica, msg.timestamp);
+  rememberWrite(msg, isUpdated);
   
   if (msg.transID != -1) { 
     if (isUpdated) {
@@ -490,12 +1309,18 @@ void MP2Node::handleUpdateMsg(Message msg) {
   }
 
   Message reply = Message(msg.transID, memberNode->addr, REPLY, isUpdated); 
-	emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+  send(&msg.fromAddr, reply);
 }
 
-void MP2Node::handleDeleteMsg(Message msg) {
-  string value = readKey(msg.key);
-  bool isDeleted = deletekey(msg.key);
+void MP2Node::handleDeleteMsg(Message &msg) {
+  bool isDeleted;
+  if (isDuplicate(msg, &isDeleted)) {
+    Message reply = Message(msg.transID, memberNode->addr, REPLY, isDeleted);
+    send(&msg.fromAddr, reply);
+    return;
+  }
+  isDeleted = deletekey(msg.key);
+  rememberWrite(msg, isDeleted);
 
   if (msg.transID != -1) { 
     if (isDeleted) {
@@ -506,7 +1331,89 @@ void MP2Node::handleDeleteMsg(Message msg) {
   }
 
   Message reply = Message(msg.transID, memberNode->addr, REPLY, isDeleted); 
-	emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+  send(&msg.fromAddr, reply);
+}
+
+void MP2Node::handleMultiGetMsg(Message &msg) {
+  vector<BatchEntry> replies;
+  replies.reserve(msg.entries.size());
+
+  for (BatchEntry &entry : msg.entries) {
+    int timestamp = 0;
+    string value = readKey(entry.key, &timestamp);
+    if (msg.transID != -1) {
+      if (value.empty()) {
+        log->logReadFail(&memberNode->addr, false, msg.transID, entry.key);
+      } else {
+        log->logReadSuccess(&memberNode->addr, false, msg.transID, entry.key, value);
+      }
+    }
+    replies.push_back({entry.key, value, !value.empty(), timestamp});
+  }
+
+  if (msg.transID != -1) {
+    sendBatch(&msg.fromAddr, msg.transID, MULTIREPLY, replies);
+  }
+}
+
+void MP2Node::handleMultiPutMsg(Message &msg) {
+  vector<BatchEntry> replies;
+  replies.reserve(msg.entries.size());
+
+  for (BatchEntry &entry : msg.entries) {
+    bool isCreated = createKeyValue(entry.key, entry.value, (ReplicaType)entry.flag, entry.timestamp);
+    if (msg.transID != -1) {
+      if (isCreated) {
+        log->logCreateSuccess(&memberNode->addr, false, msg.transID, entry.key, entry.value);
+      } else {
+        log->logCreateFail(&memberNode->addr, false, msg.transID, entry.key, entry.value);
+      }
+    }
+    replies.push_back({entry.key, "", isCreated});
+  }
+
+  if (msg.transID != -1) {
+    sendBatch(&msg.fromAddr, msg.transID, MULTIREPLY, replies);
+  }
+}
+
+void MP2Node::handleMultiReplyMsg(Message &msg) {
+  unordered_map<int, BatchTransaction>::iterator it = batch_ht->find(msg.transID);
+  if (it == batch_ht->end()) {
+    return;
+  }
+  BatchTransaction &batch = it->second;
+
+  // Per key accounting: a key completes as soon as its own quorum is decided
+  for (BatchEntry &entry : msg.entries) {
+    unordered_map<string, Transaction>::iterator k = batch.keys.find(entry.key);
+    if (k == batch.keys.end()) {
+      continue;
+    }
+    Transaction &tran = k->second;
+    int required = requiredAcks(tran.level, tran.replicas);
+    if (entry.flag) {
+      if (batch.messageType == READ && (tran.successCount == 0 || Entry(entry.value, entry.timestamp, PRIMARY).isNewerThan(Entry(tran.value, tran.version, PRIMARY)))) {
+        tran.value = entry.value;
+        tran.version = entry.timestamp;
+      }
+      tran.successCount++;
+    } else {
+      tran.failCount++;
+    }
+
+    if (tran.successCount >= required) {
+      completeRequest(msg.transID, tran, true);
+      batch.keys.erase(k);
+    } else if (tran.failCount > tran.replicas - required) {
+      completeRequest(msg.transID, tran, false);
+      batch.keys.erase(k);
+    }
+  }
+
+  if (batch.keys.empty()) {
+    batch_ht->erase(it);
+  }
 }
 
 /**
@@ -514,31 +1421,11 @@ void MP2Node::handleDeleteMsg(Message msg) {
  *
  * DESCRIPTION: Find the replicas of the given keyfunction
  * 				This function is responsible for finding the replicas of a key
+ * 				in O(log n) using the current ring index
  */
 vector<Node> MP2Node::findNodes(string key) {
-	size_t pos = hashFunction(key);
-	vector<Node> addr_vec;
-	if (ring.size() >= 3) {
-		// if pos <= min || pos > max, the leader is the min
-		if (pos <= ring.at(0).getHashCode() || pos > ring.at(ring.size()-1).getHashCode()) {
-			addr_vec.emplace_back(ring.at(0));
-			addr_vec.emplace_back(ring.at(1));
-			addr_vec.emplace_back(ring.at(2));
-		}
-		else {
-			// go through the ring until pos <= node
-			for (int i=1; i<ring.size(); i++){
-				Node addr = ring.at(i);
-				if (pos <= addr.getHashCode()) {
-					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(ring.at((i+1)%ring.size()));
-					addr_vec.emplace_back(ring.at((i+2)%ring.size()));
-					break;
-				}
-			}
-		}
-	}
-	return addr_vec;
+  // Binary search over the ring tokens; the preference list is memoized per ring version
+  return ring.findNodes(hashFunction(key));
 }
 
 /**
@@ -564,6 +1451,20 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size) {
 	Queue q;
 	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
 }
+/**
+ * FUNCTION NAME: holdsReplica
+ *
+ * DESCRIPTION: Whether the node at address is one of replicas
+ */
+static bool holdsReplica(const vector<Node> &replicas, const Address &address) {
+  for (const Node &replica : replicas) {
+    if (replica.nodeAddress.pack() == address.pack()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * FUNCTION NAME: stabilizationProtocol
  *
@@ -572,24 +1473,343 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size) {
  * 				The function does the following:
  *				1) Ensures that there are three "CORRECT" replicas of all the keys in spite of failures and joins
  *				Note:- "CORRECT" replicas implies that every key is replicated in its two neighboring nodes in the ring
+ *
+ * 				Keys whose replicas changed are streamed to their new replicas first.
+ * 				Then, instead of pushing every key to every replica, this node sends the
+ * 				Merkle tree of each range it already replicated to the other replicas of
+ * 				the range. Each of them answers with only the keys of the sub-ranges
+ * 				where the trees differ.
  */
 void MP2Node::stabilizationProtocol() {
-	/*
-	 * Implement this
-	 */
-
   Address fromAddress = memberNode->addr;
 
-  for (auto const & [key, value]: ht->hashTable) {
-    // Copy keys to new replica
-    vector<Node> replicas = findNodes(key);
-    for (unsigned i=0; i<replicas.size(); i++) {
-      Message msg = Message(-1, fromAddress, CREATE, key, value, PRIMARY);
-      if (i==1) { msg.replica = SECONDARY; }
-      if (i==2) { msg.replica = TERTIARY; }
-      emulNet->ENsend(&fromAddress, &replicas[i].nodeAddress, msg.toString());
+  streamMovedRanges();
+
+  for (size_t i = 0; i < ring.preferenceLists.size(); i++) {
+    MerkleTree &tree = trees[i];
+    // a token equal to the previous one has an empty range
+    if (ring.size() > 1 && tree.start == tree.end) {
+      continue;
+    }
+    vector<Node> &replicas = ring.preferenceLists[i];
+    if (!holdsReplica(replicas, fromAddress)) {
+      continue;
+    }
+    // a range this node just gained is being streamed to it
+    if (!previousRing.preferenceLists.empty() && !holdsReplica(previousRing.findNodes(tree.end), fromAddress)) {
+      continue;
+    }
+    string digest = Message(fromAddress, tree.start, tree.end, tree.leaves()).encode();
+    for (Node &replica : replicas) {
+      if (!(replica.nodeAddress == fromAddress)) {
+        emulNet->ENsend(&fromAddress, &replica.nodeAddress, digest);
+      }
     }
   }
+}
 
-  return;
+/**
+ * FUNCTION NAME: streamMovedRanges
+ *
+ * DESCRIPTION: Compare the old and new preference list of every key this node
+ * 				replicated and stream the keys whose replicas changed to their new
+ * 				replicas only. The replica that lost a key hands it over and drops it
+ * 				once the new replica acknowledges; when it has failed, the first old
+ * 				replica still responsible for the key sends it instead. Every node
+ * 				computes the same assignment, so each key moves once per new replica.
+ */
+void MP2Node::streamMovedRanges() {
+  Address self = memberNode->addr;
+  if (previousRing.preferenceLists.empty() || ring.preferenceLists.empty()) {
+    return;
+  }
+  int transID = ++g_transID;
+  Handoff handoff;
+  // packed new replica address -> the replica and the keys streamed to it
+  map<unsigned long long, pair<Address, vector<BatchEntry>>> perReplica;
+  RebalanceStats &stats = rebalance[ring.version];
+
+  handoff.version = ring.version;
+  for (auto const & [key, value] : ht->hashTable) {
+    size_t pos = hashFunction(key);
+    vector<Node> &oldNodes = previousRing.findNodes(pos);
+    vector<Node> &newNodes = ring.findNodes(pos);
+    if (!holdsReplica(oldNodes, self)) {
+      continue;
+    }
+
+    // Live old replicas that lost the key, and the first old replica that kept it
+    vector<Address> losers;
+    Address *keeper = NULL;
+    for (Node &node : oldNodes) {
+      if (holdsReplica(newNodes, node.nodeAddress)) {
+        keeper = (keeper == NULL) ? &node.nodeAddress : keeper;
+      } else if (isRingMember(node.nodeAddress)) {
+        losers.push_back(node.nodeAddress);
+      }
+    }
+    // Loser j hands the key to new replica j, the keeper covers failed losers
+    int gained = 0;
+    for (unsigned i = 0; i < newNodes.size(); i++) {
+      if (holdsReplica(oldNodes, newNodes[i].nodeAddress)) {
+        continue;
+      }
+      Address *sender = (gained < (int)losers.size()) ? &losers[gained] : keeper;
+      gained++;
+      if (sender == NULL || !(*sender == self)) {
+        continue;
+      }
+      pair<Address, vector<BatchEntry>> &replica = perReplica[newNodes[i].nodeAddress.pack()];
+      replica.first = newNodes[i].nodeAddress;
+      Entry entry(value);
+      replica.second.push_back({key, entry.value, (int)i, entry.timestamp});
+      stats.keysMoved++;
+      if (!holdsReplica(newNodes, self)) {
+        handoff.pendingAcks[key]++;
+      }
+    }
+  }
+
+  for (auto & [packed, replica] : perReplica) {
+    stats.bytesMoved += sendBatch(&replica.first, transID, STREAM, replica.second);
+  }
+  if (!handoff.pendingAcks.empty()) {
+    handoffs.insert({transID, std::move(handoff)});
+    trans_timeouts.schedule(transID, par->getcurrtime() + TIMEOUT + 1);
+  }
+}
+
+/**
+ * FUNCTION NAME: isRingMember
+ *
+ * DESCRIPTION: Whether the node at address is in the membership the ring was built from
+ */
+bool MP2Node::isRingMember(Address &address) {
+  return binary_search(ringMembers.begin(), ringMembers.end(), address.pack());
+}
+
+/**
+ * FUNCTION NAME: handleStreamMsg
+ *
+ * DESCRIPTION: Store the keys of a range this node became a replica of and
+ * 				acknowledge every one stored
+ */
+void MP2Node::handleStreamMsg(Message &msg) {
+  vector<BatchEntry> acks;
+  acks.reserve(msg.entries.size());
+
+  for (BatchEntry &entry : msg.entries) {
+    bool isCreated = createKeyValue(entry.key, entry.value, (ReplicaType)entry.flag, entry.timestamp);
+    acks.push_back({entry.key, "", isCreated});
+  }
+  sendBatch(&msg.fromAddr, msg.transID, STREAMACK, acks);
+}
+
+/**
+ * FUNCTION NAME: handleStreamAckMsg
+ *
+ * DESCRIPTION: Drop the handed off keys every new replica has acknowledged,
+ * 				unless a later ring change made this node a replica again
+ */
+void MP2Node::handleStreamAckMsg(Message &msg) {
+  unordered_map<int, Handoff>::iterator it = handoffs.find(msg.transID);
+  if (it == handoffs.end()) {
+    return;
+  }
+  Handoff &handoff = it->second;
+
+  for (BatchEntry &entry : msg.entries) {
+    unordered_map<string, int>::iterator k = handoff.pendingAcks.find(entry.key);
+    if (!entry.flag || k == handoff.pendingAcks.end() || --k->second > 0) {
+      continue;
+    }
+    handoff.pendingAcks.erase(k);
+    if (!holdsReplica(ring.findNodes(hashFunction(entry.key)), memberNode->addr) && deletekey(entry.key)) {
+      rebalance[handoff.version].keysDropped++;
+    }
+  }
+
+  if (handoff.pendingAcks.empty()) {
+    handoffs.erase(it);
+  }
+}
+
+/**
+ * FUNCTION NAME: isSuspected
+ *
+ * DESCRIPTION: Whether the membership protocol suspects the node at address has
+ * 				failed, while it is not yet removed from the ring
+ */
+bool MP2Node::isSuspected(Address &address) {
+  MemberListEntry *e = members->find(address.pack());
+  return e != NULL && e->suspected;
+}
+
+/**
+ * FUNCTION NAME: storeHint
+ *
+ * DESCRIPTION: Hold a write for a replica that seems down until it is back
+ */
+void MP2Node::storeHint(Address &target, BatchEntry write) {
+  HintedWrites &held = hints[target.pack()];
+  held.target = target;
+  held.writes[write.key] = write;
+}
+
+/**
+ * FUNCTION NAME: replayHints
+ *
+ * DESCRIPTION: Send the writes held for every replica no longer suspected in one
+ * 				batch. Hints for a node removed from the ring are
+ * 				dropped: the ring change streams its ranges to the new replicas.
+ */
+void MP2Node::replayHints() {
+  map<unsigned long long, HintedWrites>::iterator it = hints.begin();
+  while (it != hints.end()) {
+    HintedWrites &held = it->second;
+    if (!isRingMember(held.target)) {
+      it = hints.erase(it);
+      continue;
+    }
+    if (isSuspected(held.target)) {
+      ++it;
+      continue;
+    }
+    int transID = ++g_transID;
+    vector<BatchEntry> entries;
+    entries.reserve(held.writes.size());
+    for (auto const & [key, entry] : held.writes) {
+      entries.push_back(entry);
+    }
+    sendBatch(&held.target, transID, HINT, entries);
+    trans_timeouts.schedule(transID, par->getcurrtime() + TIMEOUT + 1);
+    replays.insert({transID, std::move(held)});
+    it = hints.erase(it);
+  }
+}
+
+/**
+ * FUNCTION NAME: handleHintMsg
+ *
+ * DESCRIPTION: Apply the writes a coordinator held for this node while it was
+ * 				unreachable, or pushed to it by read repair, keeping the newest
+ * 				version of each key. Held writes are acknowledged, repairs are not.
+ */
+void MP2Node::handleHintMsg(Message &msg) {
+  vector<BatchEntry> acks;
+  acks.reserve(msg.entries.size());
+
+  for (BatchEntry &entry : msg.entries) {
+    bool isStored = createKeyValue(entry.key, entry.value, (ReplicaType)entry.flag, entry.timestamp);
+    acks.push_back({entry.key, "", isStored});
+  }
+  if (msg.transID != -1) {
+    sendBatch(&msg.fromAddr, msg.transID, HINTACK, acks);
+  }
+}
+
+/**
+ * FUNCTION NAME: handleHintAckMsg
+ *
+ * DESCRIPTION: Forget the replayed hints the replica has stored
+ */
+void MP2Node::handleHintAckMsg(Message &msg) {
+  unordered_map<int, HintedWrites>::iterator it = replays.find(msg.transID);
+  if (it == replays.end()) {
+    return;
+  }
+  for (BatchEntry &entry : msg.entries) {
+    if (entry.flag) {
+      it->second.writes.erase(entry.key);
+    }
+  }
+  if (it->second.writes.empty()) {
+    replays.erase(it);
+  }
+}
+
+/**
+ * FUNCTION NAME: handleMerkleDigestMsg
+ *
+ * DESCRIPTION: Compare the Merkle tree of a range from another replica with the
+ * 				local one and send it the local keys of the leaves that differ
+ */
+void MP2Node::handleMerkleDigestMsg(Message &msg) {
+  MerkleTree remote(msg.rangeStart, msg.rangeEnd);
+  remote.setLeaves(msg.digest);
+
+  // Use the maintained tree when both nodes agree on the range, otherwise build one
+  MerkleTree local(msg.rangeStart, msg.rangeEnd);
+  int range = ring.rangeOf(msg.rangeEnd);
+  if (!trees.empty() && trees[range].start == msg.rangeStart && trees[range].end == msg.rangeEnd) {
+    local = trees[range];
+  } else {
+    for (auto const & [key, stored] : ht->hashTable) {
+      size_t pos = hashFunction(key);
+      if (local.contains(pos)) {
+        local.toggle(pos, key, versionOf(stored));
+      }
+    }
+  }
+  if (local.root() == remote.root()) {
+    return;
+  }
+
+  vector<bool> differs(MERKLE_LEAVES, false);
+  for (int leaf : local.diff(remote)) {
+    differs[leaf] = true;
+  }
+  vector<BatchEntry> entries;
+  for (auto const & [key, stored] : ht->hashTable) {
+    size_t pos = hashFunction(key);
+    if (local.contains(pos) && differs[local.leafOf(pos)]) {
+      Entry entry(stored);
+      entries.push_back({key, entry.value, PRIMARY, entry.timestamp});
+    }
+  }
+  // The replica type only labels the entry the receiver stores
+  sendBatch(&msg.fromAddr, -1, MULTIPUT, entries);
+}
+
+/**
+ * FUNCTION NAME: rebuildTrees
+ *
+ * DESCRIPTION: Rebuild the Merkle tree of every range of a new ring version from the hash table
+ */
+void MP2Node::rebuildTrees() {
+  trees.clear();
+  if (ring.preferenceLists.empty()) {
+    return;
+  }
+  trees.reserve(ring.size());
+  for (size_t i = 0; i < ring.size(); i++) {
+    trees.emplace_back(ring.tokens[(i + ring.size() - 1) % ring.size()], ring.tokens[i]);
+  }
+  for (auto const & [key, stored] : ht->hashTable) {
+    toggleTree(key, stored);
+  }
+}
+
+/**
+ * FUNCTION NAME: toggleTree
+ *
+ * DESCRIPTION: Add an entry stored in the hash table to the Merkle tree of its range,
+ * 				or remove one that is no longer stored
+ */
+void MP2Node::toggleTree(const string &key, const string &stored) {
+  if (trees.empty()) {
+    return;
+  }
+  size_t pos = hashFunction(key);
+  trees[ring.rangeOf(pos)].toggle(pos, key, versionOf(stored));
+}
+
+/**
+ * FUNCTION NAME: versionOf
+ *
+ * DESCRIPTION: The value and timestamp of a stored entry. The replica type differs
+ * 				between the replicas of a key, so it is left out of the Merkle hashes.
+ */
+string MP2Node::versionOf(const string &stored) {
+  return stored.substr(0, stored.rfind(':'));
 }
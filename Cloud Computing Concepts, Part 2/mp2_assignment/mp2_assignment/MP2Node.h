@@ -18,16 +18,46 @@
 #include "Params.h"
 #include "Message.h"
 #include "Queue.h"
+#include "RingIndex.h"
+#include "TimerWheel.h"
+#include "CompletedFilter.h"
+#include "MerkleTree.h"
+#include "MembershipTable.h"
 
 /**
- * CLASS NAME: MP2Node
+ * STRUCT NAME: RequestResult
  *
- * DESCRIPTION: This class encapsulates all the key-value store functionality
- * 				including:
- * 				1) Ring
- * 				2) Stabilization Protocol
- * 				3) Server side CRUD APIs
- * 				4) Client side CRUD APIs
+ * DESCRIPTION: Outcome of a client request for one key, handed to its completion callback
+ */
+struct RequestResult {
+  int transID;
+  MessageType type;
+  string key;
+  // value read or written; empty for a DELETE and a failed READ
+  string value;
+  bool success;
+  // ticks from the request to its completion
+  int latency;
+};
+
+// Completion callback of a client request, run once per key when it succeeds or fails
+typedef function<void(const RequestResult &)> Completion;
+
+/**
+ * STRUCT NAME: DigestAnswer
+ *
+ * DESCRIPTION: Digest and version of its value a replica answered a digest READ with
+ */
+struct DigestAnswer {
+  Address replica;
+  unsigned long long digest;
+  int timestamp;
+};
+
+/**
+ * STRUCT NAME: Transaction
+ *
+ * DESCRIPTION: Client request for one key, kept by its coordinator until the replicas settle it
  */
 struct Transaction {
   int successCount;
@@ -36,20 +66,152 @@ struct Transaction {
   string key;
   string value;
   int timestamp;
+  // acks required to succeed, out of the replicas the request was sent to
+  ConsistencyLevel level;
+  int replicas;
+  // READ: version of value, and the version every replica answered with
+  int version;
+  vector<pair<Address, Entry>> answers;
+  // digest READ: whether a full value has been read, and the digests not yet
+  // compared to it
+  bool hasData;
+  vector<DigestAnswer> digests;
+  // hedged READ: replicas not asked yet
+  vector<Address> standby;
+  // called with the outcome, if set
+  Completion done;
+  // replicas asked that have not answered, with their ReplicaType for a write or the
+  // READ or READDIGEST they were sent for a read, and retries so far
+  vector<pair<Address, int>> unanswered;
+  int retries;
+};
+
+/**
+ * STRUCT NAME: BatchTransaction
+ *
+ * DESCRIPTION: Parent transaction of a multi-key request. Every key keeps its own
+ * 				Transaction and is removed once it succeeds or fails.
+ */
+struct BatchTransaction {
+  // CREATE for clientMultiPut, READ for clientMultiGet
+  MessageType messageType;
+  unordered_map<string, Transaction> keys;
+};
+
+/**
+ * STRUCT NAME: LatencyStats
+ *
+ * DESCRIPTION: Coordinator latency, in ticks, of the requests of one consistency level
+ */
+struct LatencyStats {
+  unsigned long requests;
+  unsigned long failed;
+  // ticks from request to success -> number of successful requests
+  map<int, unsigned long> ticks;
+  LatencyStats(): requests(0), failed(0) {}
+};
+
+/**
+ * STRUCT NAME: RebalanceStats
+ *
+ * DESCRIPTION: Range streaming cost of one ring change seen by a node: keys and
+ * 				bytes it streamed to new replicas and keys it dropped once acknowledged
+ */
+struct RebalanceStats {
+  unsigned long keysMoved;
+  unsigned long bytesMoved;
+  unsigned long keysDropped;
+  RebalanceStats(): keysMoved(0), bytesMoved(0), keysDropped(0) {}
+};
+
+/**
+ * STRUCT NAME: Handoff
+ *
+ * DESCRIPTION: Keys this node streamed to new replicas after losing them on a
+ * 				ring change, each with the number of acks still outstanding
+ */
+struct Handoff {
+  int version;
+  unordered_map<string, int> pendingAcks;
 };
 
+/**
+ * STRUCT NAME: HintedWrites
+ *
+ * DESCRIPTION: Writes held for a replica that was suspected to have failed, by key.
+ * 				Only the latest value of a key is kept.
+ */
+struct HintedWrites {
+  Address target;
+  unordered_map<string, BatchEntry> writes;
+};
+
+/**
+ * CLASS NAME: MP2Node
+ *
+ * DESCRIPTION: This class encapsulates all the key-value store functionality
+ * 				including:
+ * 				1) Ring
+ * 				2) Stabilization Protocol
+ * 				3) Server side CRUD APIs
+ * 				4) Client side CRUD APIs
+ */
 class MP2Node {
 private:
 	// Vector holding the next two neighbors in the ring who have my replicas
 	vector<Node> hasMyReplicas;
 	// Vector holding the previous two neighbors in the ring whose replicas I have
 	vector<Node> haveReplicasOf;
-	// Ring
-	vector<Node> ring;
+	// Ring: sorted tokens and memoized preference lists of the current ring version
+	RingIndex ring;
+	// The ring version before the last membership change
+	RingIndex previousRing;
+	// Sorted packed addresses of the members the ring was built from
+	vector<unsigned long long> ringMembers;
 	// Hash Table
 	HashTable * ht;
+	// Merkle tree of the keys held in every range of the ring, indexed like the ring ranges
+	vector<MerkleTree> trees;
   // Hash Table to keep track of the transactions
-  map<int, Transaction>* trans_ht;
+  unordered_map<int, Transaction>* trans_ht;
+  // Hash Table to keep track of the multi-key transactions
+  unordered_map<int, BatchTransaction>* batch_ht;
+  // Timeout of every transaction; finished transactions are skipped when they fire
+  TimerWheel trans_timeouts;
+  // READs to follow up on if their replicas have not answered in time: digest READs
+  // fetch a full value, hedged READs ask the replicas left out
+  TimerWheel read_followups;
+  // Latency of the requests this node coordinated, per consistency level
+  LatencyStats latency[CONSISTENCY_LEVELS];
+  // Keys handed off on ring changes and waiting for acks, by stream transaction
+  unordered_map<int, Handoff> handoffs;
+  // Range streaming cost per ring version
+  map<int, RebalanceStats> rebalance;
+  // Hinted writes waiting for their replica, by packed replica address
+  map<unsigned long long, HintedWrites> hints;
+  // Hinted writes replayed and waiting for acks, by replay transaction
+  unordered_map<int, HintedWrites> replays;
+  // Newest version returned by a completed READ, to repair replicas that answer late
+  unordered_map<int, BatchEntry> repairs;
+  // Messages this node sent itself, handled without going through EmulNet
+  queue<Message> loopback;
+  // Completion callbacks of finished requests, run once no handler is running
+  queue<pair<Completion, RequestResult>> completions;
+  // Next retry of every open transaction; finished transactions are skipped when they fire
+  TimerWheel retry_timers;
+  // Outcome of the latest writes applied here, by packed coordinator address and transID,
+  // so that a retried write is answered again rather than applied twice; oldest evicted first
+  map<pair<unsigned long long, int>, bool> applied;
+  queue<pair<unsigned long long, int>> appliedOrder;
+  // Transactions this node coordinated that have finished, to drop late replies undecoded
+  CompletedFilter completed;
+  // Finished READs each replica has not answered, piggybacked on the next request to it
+  unordered_map<unsigned long long, vector<int>> cancelHints;
+  // READs coordinators have cancelled, by packed coordinator address and transID; oldest evicted first
+  set<pair<unsigned long long, int>> cancelledReads;
+  queue<pair<unsigned long long, int>> cancelledOrder;
+  // Index of memberNode->memberList kept by the membership protocol, to look members up by address
+  MembershipTable *members;
 	// Member representing this member
 	Member *memberNode;
 	// Params object
@@ -64,6 +226,21 @@ public:
 	Member * getMemberNode() {
 		return this->memberNode;
 	}
+	RingIndex * getRing() {
+		return &this->ring;
+	}
+	unsigned long getKeyCount() {
+		return this->ht->currentSize();
+	}
+	LatencyStats * getLatencyStats(ConsistencyLevel level) {
+		return &this->latency[level];
+	}
+	map<int, RebalanceStats> * getRebalanceStats() {
+		return &this->rebalance;
+	}
+	void setMembershipTable(MembershipTable *members) {
+		this->members = members;
+	}
 
 	// ring functionalities
 	void updateRing();
@@ -71,11 +248,17 @@ public:
 	size_t hashFunction(string key);
 	void findNeighbors();
 
-	// client side CRUD APIs
-	void clientCreate(string key, string value);
-	void clientRead(string key);
-	void clientUpdate(string key, string value);
-	void clientDelete(string key);
+	// client side CRUD APIs; they return the transID of the request and call done,
+	// if set, once it completes
+	int clientCreate(string key, string value, ConsistencyLevel level = QUORUM, Completion done = nullptr);
+	int clientRead(string key, ConsistencyLevel level = QUORUM, Completion done = nullptr);
+	int clientUpdate(string key, string value, ConsistencyLevel level = QUORUM, Completion done = nullptr);
+	int clientDelete(string key, ConsistencyLevel level = QUORUM, Completion done = nullptr);
+
+	// client side multi-key APIs, one message per replica for a whole batch;
+	// done is called for every key
+	int clientMultiGet(vector<string> keys, ConsistencyLevel level = QUORUM, Completion done = nullptr);
+	int clientMultiPut(vector<pair<string, string>> kvs, ConsistencyLevel level = QUORUM, Completion done = nullptr);
 
 	// receive messages from Emulnet
 	bool recvLoop();
@@ -83,12 +266,50 @@ public:
 
 	// handle messages from receiving queue
 	void checkMessages();
-  void handleReplyMsg(Message msg);
-  void handleReadReplyMsg(Message msg);
-  void handleCreateMsg(Message msg);
-  void handleReadMsg(Message msg);
-  void handleUpdateMsg(Message msg);
-  void handleDeleteMsg(Message msg);
+	void handleMessage(Message &msg);
+	size_t send(Address *toAddr, Message &msg);
+	void drainLoopback();
+	bool isLateReply(const char *data, int size);
+	void noteCancelled(Message &msg);
+	bool isCancelled(Message &msg);
+  void handleReplyMsg(Message &msg);
+  void handleReadReplyMsg(Message &msg);
+  void handleCreateMsg(Message &msg);
+  void handleReadMsg(Message &msg);
+  void handleUpdateMsg(Message &msg);
+  void handleDeleteMsg(Message &msg);
+  void handleMultiGetMsg(Message &msg);
+  void handleMultiPutMsg(Message &msg);
+  void handleMultiReplyMsg(Message &msg);
+  void handleMerkleDigestMsg(Message &msg);
+  void handleStreamMsg(Message &msg);
+  void handleStreamAckMsg(Message &msg);
+  void handleHintMsg(Message &msg);
+  void handleHintAckMsg(Message &msg);
+  void handleReadDigestMsg(Message &msg);
+  void handleDigestReplyMsg(Message &msg);
+
+	// coordinator transaction table
+	void addTransaction(int transID, Transaction tran);
+	static int requiredAcks(ConsistencyLevel level, int replicas);
+	void completeRequest(int transID, Transaction &tran, bool success);
+	void finishTransaction(int transID, bool success);
+	int startBatch(MessageType type, const vector<pair<string, string>> &kvs, ConsistencyLevel level, Completion done);
+	size_t sendBatch(Address *toAddr, int transID, MessageType type, const vector<BatchEntry> &entries);
+	void expireTransactions();
+	void retryRequests();
+	Message requestFor(int transID, Transaction &tran, int kind);
+	static void markAnswered(Transaction &tran, Address &replica);
+	bool isDuplicate(Message &msg, bool *success);
+	void rememberWrite(Message &msg, bool success);
+	void settleRead(int transID, Transaction &tran);
+	void settleWrite(int transID, Transaction &tran);
+	void resolveDigests(int transID, Transaction &tran);
+	void followUpReads();
+	void hedgeRead(int transID, Transaction &tran);
+	static unsigned long long valueDigest(const string &value, int timestamp);
+	void readRepair(int transID, Transaction &tran);
+	void repairReplica(Address &replica, const BatchEntry &newest);
 
 	// coordinator dispatches messages to corresponding nodes
 	void dispatchMessages(Message message);
@@ -97,13 +318,25 @@ public:
 	vector<Node> findNodes(string key);
 
 	// server
-	bool createKeyValue(string key, string value, ReplicaType replica);
-	string readKey(string key);
-	bool updateKeyValue(string key, string value, ReplicaType replica);
+	bool createKeyValue(string key, string value, ReplicaType replica, int timestamp);
+	string readKey(string key, int *timestamp = NULL);
+	bool updateKeyValue(string key, string value, ReplicaType replica, int timestamp);
 	bool deletekey(string key);
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
+	void streamMovedRanges();
+	bool isRingMember(Address &address);
+
+	// hinted handoff for writes to replicas suspected to have failed
+	bool isSuspected(Address &address);
+	void storeHint(Address &target, BatchEntry write);
+	void replayHints();
+
+	// anti-entropy Merkle trees over the local hash table
+	void rebuildTrees();
+	void toggleTree(const string &key, const string &stored);
+	static string versionOf(const string &stored);
 
 	~MP2Node();
 };
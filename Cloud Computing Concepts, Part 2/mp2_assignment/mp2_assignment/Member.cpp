@@ -38,12 +38,12 @@ bool Address::operator ==(const Address& anotherAddress) {
 /**
  * Constructor
  */
-MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp) {}
+MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), suspected(false), heartbeat(heartbeat), timestamp(timestamp) {}
 
 /**
  * Constuctor
  */
-MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
+MemberListEntry::MemberListEntry(int id, short port): id(id), port(port), suspected(false) {}
 
 /**
  * Copy constructor
@@ -52,6 +52,7 @@ MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 	this->heartbeat = anotherMLE.heartbeat;
 	this->id = anotherMLE.id;
 	this->port = anotherMLE.port;
+	this->suspected = anotherMLE.suspected;
 	this->timestamp = anotherMLE.timestamp;
 }
 
@@ -63,6 +64,7 @@ MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE)
 	swap(heartbeat, temp.heartbeat);
 	swap(id, temp.id);
 	swap(port, temp.port);
+	swap(suspected, temp.suspected);
 	swap(timestamp, temp.timestamp);
 	return *this;
 }
@@ -103,6 +105,15 @@ long MemberListEntry::gettimestamp() {
 	return timestamp;
 }
 
+/**
+ * FUNCTION NAME: getsuspected
+ *
+ * DESCRIPTION: getter
+ */
+bool MemberListEntry::getsuspected() {
+	return suspected;
+}
+
 /**
  * FUNCTION NAME: setid
  *
@@ -139,6 +150,15 @@ void MemberListEntry::settimestamp(long timestamp) {
 	this->timestamp = timestamp;
 }
 
+/**
+ * FUNCTION NAME: setsuspected
+ *
+ * DESCRIPTION: setter
+ */
+void MemberListEntry::setsuspected(bool suspected) {
+	this->suspected = suspected;
+}
+
 /**
  * Copy Constructor
  */
@@ -52,6 +52,12 @@ public:
 	void init() {
 		memset(&addr, 0, sizeof(addr));
 	}
+	// Pack the 6 address bytes into an integer key
+	unsigned long long pack() const {
+		unsigned long long key = 0;
+		memcpy(&key, addr, sizeof(addr));
+		return key;
+	}
 };
 
 /**
@@ -63,21 +69,25 @@ class MemberListEntry {
 public:
 	int id;
 	short port;
+	// set by the membership protocol while it suspects the member has failed
+	bool suspected;
 	long heartbeat;
 	long timestamp;
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
-	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
+	MemberListEntry(): id(0), port(0), suspected(false), heartbeat(0), timestamp(0) {}
 	MemberListEntry(const MemberListEntry &anotherMLE);
 	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
 	int getid();
 	short getport();
 	long getheartbeat();
 	long gettimestamp();
+	bool getsuspected();
 	void setid(int id);
 	void setport(short port);
 	void setheartbeat(long hearbeat);
 	void settimestamp(long timestamp);
+	void setsuspected(bool suspected);
 };
 
 /**
@@ -0,0 +1,248 @@
+/**********************************
+ * FILE NAME: MembershipTable.cpp
+ *
+ * DESCRIPTION: MembershipTable class definition
+ **********************************/
+
+#include "MembershipTable.h"
+
+/**
+ * FUNCTION NAME: attach
+ *
+ * DESCRIPTION: Index list, which must outlive the table
+ */
+void MembershipTable::attach(vector<MemberListEntry> *list) {
+	this->list = list;
+	rebuild();
+}
+
+/**
+ * FUNCTION NAME: rebuild
+ *
+ * DESCRIPTION: Index the list again after it was rewritten
+ */
+void MembershipTable::rebuild() {
+	index.clear();
+	for ( size_t i = 0; i < list->size(); i++ ) {
+		index.emplace(key((*list)[i].id, (*list)[i].port), i);
+	}
+}
+
+/**
+ * FUNCTION NAME: key
+ *
+ * DESCRIPTION: (id, port) packed the way Address::pack packs the address
+ */
+unsigned long long MembershipTable::key(int id, short port) {
+	Address addr;
+	memcpy(&addr.addr[0], &id, sizeof(int));
+	memcpy(&addr.addr[4], &port, sizeof(short));
+	return addr.pack();
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Entry of (id, port), NULL if it is not in the list. The pointer
+ * 				is valid until the list next grows.
+ */
+MemberListEntry *MembershipTable::find(int id, short port) {
+	return find(key(id, port));
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Entry of a packed (id, port), NULL if it is not in the list
+ */
+MemberListEntry *MembershipTable::find(unsigned long long key) {
+	FlatHashMap<size_t, unsigned long long>::iterator it = index.find(key);
+	if ( it == index.end() ) {
+		return NULL;
+	}
+	return &(*list)[it->second];
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Append an entry that is not in the list yet
+ */
+void MembershipTable::add(const MemberListEntry &entry) {
+	index.emplace(key(entry.id, entry.port), list->size());
+	list->push_back(entry);
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Remove the entry of a packed (id, port). The last entry of the list
+ * 				takes its place, so the order of the list is not kept.
+ *
+ * RETURNS:
+ * true if the entry was in the list
+ */
+bool MembershipTable::remove(unsigned long long key) {
+	FlatHashMap<size_t, unsigned long long>::iterator it = index.find(key);
+	if ( it == index.end() ) {
+		return false;
+	}
+	size_t pos = it->second;
+	index.erase(key);
+	if ( pos + 1 != list->size() ) {
+		(*list)[pos] = list->back();
+		index.find(MembershipTable::key(list->back().id, list->back().port))->second = pos;
+	}
+	list->pop_back();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: bury
+ *
+ * DESCRIPTION: Remember the last heartbeat of a member that was removed from the list
+ */
+void MembershipTable::bury(const MemberListEntry &entry, long now) {
+	unsigned long long k = key(entry.id, entry.port);
+	removed.erase(k);
+	removed.emplace(k, make_pair(entry.heartbeat, now));
+}
+
+/**
+ * FUNCTION NAME: expireTombstones
+ *
+ * DESCRIPTION: Forget the members removed more than keep ticks ago
+ */
+void MembershipTable::expireTombstones(long now, long keep) {
+	vector<unsigned long long> expired;
+	for ( FlatHashMap<pair<long, long>, unsigned long long>::iterator it = removed.begin(); it != removed.end(); ++it ) {
+		if ( it->second.second + keep < now ) {
+			expired.push_back(it->first);
+		}
+	}
+	for ( unsigned long long k : expired ) {
+		removed.erase(k);
+	}
+}
+
+/**
+ * FUNCTION NAME: merge
+ *
+ * DESCRIPTION: Merge one received entry. A newer heartbeat of a member heard from
+ * 				within window is taken with the local time now; a member silent for
+ * 				longer is left to expire. An unknown member is added, unless it was
+ * 				removed and the entry has no newer heartbeat than it was removed
+ * 				with: a node that has not removed a failed member yet would
+ * 				otherwise add it back everywhere.
+ */
+MergeResult MembershipTable::merge(const MemberListEntry &entry, long now, long window) {
+	MemberListEntry *local = find(entry.id, entry.port);
+	if ( local == NULL ) {
+		unsigned long long k = key(entry.id, entry.port);
+		FlatHashMap<pair<long, long>, unsigned long long>::iterator gone = removed.find(k);
+		if ( gone != removed.end() ) {
+			if ( entry.heartbeat <= gone->second.first ) {
+				return MERGE_UNCHANGED;
+			}
+			removed.erase(k);
+		}
+		MemberListEntry added(entry);
+		added.timestamp = now;
+		add(added);
+		return MERGE_ADDED;
+	}
+	if ( entry.heartbeat > local->heartbeat && local->timestamp + window >= now ) {
+		local->heartbeat = entry.heartbeat;
+		local->timestamp = now;
+		return MERGE_REFRESHED;
+	}
+	return MERGE_UNCHANGED;
+}
+
+/**
+ * FUNCTION NAME: digest
+ *
+ * DESCRIPTION: Hash of the set of members, independent of their order in the list,
+ * 				so two nodes can tell in 8 bytes whether they know the same members
+ */
+unsigned long long MembershipTable::digest() {
+	unsigned long long digest = 0;
+	for ( const MemberListEntry &entry : *list ) {
+		// splitmix64 finalizer, so that the sum does not cancel out on close ids
+		unsigned long long z = key(entry.id, entry.port) + 0x9e3779b97f4a7c15ULL;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		digest += z ^ (z >> 31);
+	}
+	return digest;
+}
+
+/**
+ * FUNCTION NAME: putVarint
+ *
+ * DESCRIPTION: Append an unsigned LEB128 varint to the buffer, return the new end
+ */
+char *MembershipTable::putVarint(char *out, unsigned long long v) {
+	while ( v >= 0x80 ) {
+		*out++ = (char)(v | 0x80);
+		v >>= 7;
+	}
+	*out++ = (char)v;
+	return out;
+}
+
+/**
+ * FUNCTION NAME: getVarint
+ *
+ * DESCRIPTION: Read a varint, return NULL if it runs past end
+ */
+const char *MembershipTable::getVarint(const char *in, const char *end, unsigned long long *v) {
+	unsigned long long ret = 0;
+	int shift = 0;
+	while ( in < end && shift < 70 ) {
+		unsigned char b = (unsigned char)*in++;
+		ret |= (unsigned long long)(b & 0x7f) << shift;
+		if ( !(b & 0x80) ) {
+			*v = ret;
+			return in;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+/**
+ * FUNCTION NAME: packedSize
+ *
+ * DESCRIPTION: Most bytes pack writes for n entries
+ */
+size_t MembershipTable::packedSize(int n) {
+	return 1 + 5 + (size_t)n * MEMBERSHIP_ENTRY_MAX;
+}
+
+/**
+ * FUNCTION NAME: pack
+ *
+ * DESCRIPTION: Write n entries in the membership wire format, return the new end:
+ * 				version(1) count, then per entry the id as a difference from the
+ * 				previous id, the port, and the heartbeat as a difference from the
+ * 				previous heartbeat, all zigzag varints. The local timestamp is left
+ * 				out. Entries sorted by id, with heartbeats that move together, take
+ * 				about 3 bytes each instead of the 32 of a MemberListEntry.
+ */
+char *MembershipTable::pack(const MemberListEntry *entries, int n, char *out) {
+	long long id = 0, heartbeat = 0;
+	*out++ = (char)MEMBERSHIP_WIRE_VERSION;
+	out = putVarint(out, (unsigned long long)n);
+	for ( int i = 0; i < n; i++ ) {
+		long long delta = (long long)entries[i].id - id;
+		out = putVarint(out, ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+		long long p = entries[i].port;
+		out = putVarint(out, ((unsigned long long)p << 1) ^ (unsigned long long)(p >> 63));
+		delta = (long long)entries[i].heartbeat - heartbeat;
+		out = putVarint(out, ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+		id = entries[i].id;
+		heartbeat = entries[i].heartbeat;
+	}
+	return out;
+}
@@ -0,0 +1,102 @@
+/**********************************
+ * FILE NAME: MembershipTable.h
+ *
+ * DESCRIPTION: Header file MembershipTable class
+ **********************************/
+
+#ifndef MEMBERSHIPTABLE_H_
+#define MEMBERSHIPTABLE_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+#include "FlatHashMap.h"
+
+/*
+ * Macros
+ */
+// version byte leading a packed list of entries
+#define MEMBERSHIP_WIRE_VERSION 1
+// most bytes one packed entry takes: id delta, port and heartbeat delta
+#define MEMBERSHIP_ENTRY_MAX (5 + 3 + 10)
+
+// outcome of merging one received entry
+enum MergeResult { MERGE_UNCHANGED, MERGE_REFRESHED, MERGE_ADDED };
+
+/**
+ * CLASS NAME: MembershipTable
+ *
+ * DESCRIPTION: Index of a membership list by packed (id, port), so that merging
+ * 				a received list costs O(entries received) instead of a scan of the
+ * 				local list per entry. The list itself stays the plain vector in
+ * 				Member that MP2Node iterates; whoever rewrites it rebuilds the index.
+ */
+class MembershipTable {
+	vector<MemberListEntry> *list;
+	// packed (id, port) -> position in list
+	FlatHashMap<size_t, unsigned long long> index;
+	// packed (id, port) of a removed member -> its last heartbeat and the time it was removed
+	FlatHashMap<pair<long, long>, unsigned long long> removed;
+
+	static char *putVarint(char *out, unsigned long long v);
+	static const char *getVarint(const char *in, const char *end, unsigned long long *v);
+
+public:
+	MembershipTable(): list(NULL) {}
+	void attach(vector<MemberListEntry> *list);
+	void rebuild();
+	static unsigned long long key(int id, short port);
+	MemberListEntry *find(int id, short port);
+	MemberListEntry *find(unsigned long long key);
+	void add(const MemberListEntry &entry);
+	bool remove(unsigned long long key);
+	void bury(const MemberListEntry &entry, long now);
+	void expireTombstones(long now, long keep);
+	MergeResult merge(const MemberListEntry &entry, long now, long window);
+	unsigned long long digest();
+	static size_t packedSize(int n);
+	static char *pack(const MemberListEntry *entries, int n, char *out);
+	template <class F> static bool unpack(const char *in, const char *end, F visit);
+};
+
+/**
+ * FUNCTION NAME: unpack
+ *
+ * DESCRIPTION: Decode a list written by pack, calling visit with each entry in turn.
+ * 				Entries are decoded on the stack, so a receiver merges them straight
+ * 				from the receive buffer. The timestamps are 0: the receiver sets its
+ * 				own.
+ *
+ * RETURNS:
+ * false if the list has another version or runs past end; the entries before
+ * the fault have been visited
+ */
+template <class F>
+bool MembershipTable::unpack(const char *in, const char *end, F visit) {
+	unsigned long long count, v;
+	if ( in >= end || (unsigned char)*in++ != MEMBERSHIP_WIRE_VERSION || (in = getVarint(in, end, &count)) == NULL ) {
+		return false;
+	}
+	long long id = 0, heartbeat = 0;
+	for ( unsigned long long i = 0; i < count; i++ ) {
+		MemberListEntry entry;
+		if ( (in = getVarint(in, end, &v)) == NULL ) {
+			return false;
+		}
+		// zigzag: 2n for n >= 0, 2|n| - 1 for n < 0
+		id += (long long)(v >> 1) ^ -(long long)(v & 1);
+		if ( (in = getVarint(in, end, &v)) == NULL ) {
+			return false;
+		}
+		entry.port = (short)((long long)(v >> 1) ^ -(long long)(v & 1));
+		if ( (in = getVarint(in, end, &v)) == NULL ) {
+			return false;
+		}
+		heartbeat += (long long)(v >> 1) ^ -(long long)(v & 1);
+		entry.id = (int)id;
+		entry.heartbeat = heartbeat;
+		visit(entry);
+	}
+	return true;
+}
+
+#endif /* MEMBERSHIPTABLE_H_ */
@@ -0,0 +1,134 @@
+/**********************************
+ * FILE NAME: MerkleTree.cpp
+ *
+ * DESCRIPTION: MerkleTree class definition
+ **********************************/
+
+#include "MerkleTree.h"
+
+/**
+ * constructor
+ */
+MerkleTree::MerkleTree(size_t start, size_t end): start(start), end(end), nodes(2 * MERKLE_LEAVES, 0) {
+	for ( int i = MERKLE_LEAVES - 1; i > 0; i-- ) {
+		rehash(i);
+	}
+}
+
+/**
+ * Destructor
+ */
+MerkleTree::~MerkleTree() {}
+
+/**
+ * FUNCTION NAME: contains
+ *
+ * DESCRIPTION: Whether ring position pos falls in the range of the tree
+ */
+bool MerkleTree::contains(size_t pos) {
+	if ( start == end ) {
+		return true;
+	}
+	size_t off = Partitioner::offset(start, pos);
+	return off > 0 && off <= Partitioner::offset(start, end);
+}
+
+/**
+ * FUNCTION NAME: leafOf
+ *
+ * DESCRIPTION: Leaf of ring position pos, which must be in the range
+ */
+int MerkleTree::leafOf(size_t pos) {
+	double share;
+	if ( start == end ) {
+		share = Partitioner::distance(start, pos);
+	}
+	else {
+		share = (double)Partitioner::offset(start, pos) / (double)Partitioner::offset(start, end);
+	}
+	return min(MERKLE_LEAVES - 1, (int)(share * MERKLE_LEAVES));
+}
+
+/**
+ * FUNCTION NAME: toggle
+ *
+ * DESCRIPTION: Add the pair (key, value) at ring position pos to the tree, or
+ * 				remove it if it is already there
+ */
+void MerkleTree::toggle(size_t pos, const string &key, const string &value) {
+	// the key length keeps ("ab", "c") and ("a", "bc") apart
+	unsigned long long h = Partitioner::xxh64(key.data(), key.size(), key.size());
+	h = Partitioner::xxh64(value.data(), value.size(), h);
+	int node = MERKLE_LEAVES + leafOf(pos);
+	nodes[node] ^= h;
+	for ( node /= 2; node > 0; node /= 2 ) {
+		rehash(node);
+	}
+}
+
+/**
+ * FUNCTION NAME: root
+ *
+ * DESCRIPTION: Root hash, equal on two trees holding the same pairs
+ */
+unsigned long long MerkleTree::root() {
+	return nodes[1];
+}
+
+/**
+ * FUNCTION NAME: leaves
+ *
+ * DESCRIPTION: Leaf hashes, all the other nodes can be rebuilt from
+ */
+vector<unsigned long long> MerkleTree::leaves() {
+	return vector<unsigned long long>(nodes.begin() + MERKLE_LEAVES, nodes.end());
+}
+
+/**
+ * FUNCTION NAME: setLeaves
+ *
+ * DESCRIPTION: Rebuild the tree from the leaf hashes of another node's tree
+ */
+void MerkleTree::setLeaves(const vector<unsigned long long> &leaves) {
+	for ( int i = 0; i < MERKLE_LEAVES; i++ ) {
+		nodes[MERKLE_LEAVES + i] = (i < (int)leaves.size()) ? leaves[i] : 0;
+	}
+	for ( int i = MERKLE_LEAVES - 1; i > 0; i-- ) {
+		rehash(i);
+	}
+}
+
+/**
+ * FUNCTION NAME: diff
+ *
+ * DESCRIPTION: Leaves whose hash differs from other, found by descending only
+ * 				into the subtrees whose hashes differ
+ */
+vector<int> MerkleTree::diff(MerkleTree &other) {
+	vector<int> differing;
+	vector<int> stack(1, 1);
+	while ( !stack.empty() ) {
+		int node = stack.back();
+		stack.pop_back();
+		if ( nodes[node] == other.nodes[node] ) {
+			continue;
+		}
+		if ( node >= MERKLE_LEAVES ) {
+			differing.push_back(node - MERKLE_LEAVES);
+			continue;
+		}
+		stack.push_back(2 * node + 1);
+		stack.push_back(2 * node);
+	}
+	return differing;
+}
+
+/**
+ * FUNCTION NAME: rehash
+ *
+ * DESCRIPTION: Recompute an inner node from its two children
+ */
+void MerkleTree::rehash(int node) {
+	unsigned long long children[2] = {nodes[2 * node], nodes[2 * node + 1]};
+	nodes[node] = Partitioner::xxh64((const char *)children, sizeof(children), 0);
+}
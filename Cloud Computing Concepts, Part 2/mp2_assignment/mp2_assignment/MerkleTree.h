@@ -0,0 +1,51 @@
+/**********************************
+ * FILE NAME: MerkleTree.h
+ *
+ * DESCRIPTION: Header file MerkleTree class
+ **********************************/
+
+#ifndef MERKLETREE_H_
+#define MERKLETREE_H_
+
+#include "stdincludes.h"
+#include "Partitioner.h"
+
+/*
+ * Macros
+ */
+// depth of every tree; a range is split into MERKLE_LEAVES equal sub-ranges
+#define MERKLE_DEPTH 6
+#define MERKLE_LEAVES (1 << MERKLE_DEPTH)
+
+/**
+ * CLASS NAME: MerkleTree
+ *
+ * DESCRIPTION: Hash tree over the keys a node holds in one token range (start, end].
+ * 				The range is cut into MERKLE_LEAVES equal sub-ranges; a leaf is the XOR
+ * 				of the hashes of its (key, value) pairs, so adding or removing a pair
+ * 				only rehashes the path from its leaf to the root. Two replicas holding
+ * 				the same pairs have equal roots, and walking down the nodes that differ
+ * 				finds the sub-ranges to stream. start == end covers the whole ring.
+ */
+class MerkleTree {
+public:
+	size_t start;
+	size_t end;
+	// nodes[1] is the root, nodes[i] has children nodes[2i] and nodes[2i+1],
+	// and the leaves are nodes[MERKLE_LEAVES] to nodes[2 * MERKLE_LEAVES - 1]
+	vector<unsigned long long> nodes;
+	MerkleTree(size_t start, size_t end);
+	bool contains(size_t pos);
+	int leafOf(size_t pos);
+	void toggle(size_t pos, const string &key, const string &value);
+	unsigned long long root();
+	vector<unsigned long long> leaves();
+	void setLeaves(const vector<unsigned long long> &leaves);
+	vector<int> diff(MerkleTree &other);
+	virtual ~MerkleTree();
+
+private:
+	void rehash(int node);
+};
+
+#endif /* MERKLETREE_H_ */
@@ -8,51 +8,486 @@
 /**
  * Constructor
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
-// transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
+// Text (debug) format:
+// transID::fromAddr::CREATE::key::value::ReplicaType::timestamp
+// transID::fromAddr::READ|READDIGEST::key
+// transID::fromAddr::UPDATE::key::value::ReplicaType::timestamp
 // transID::fromAddr::DELETE::key
 // transID::fromAddr::REPLY::sucess
-// transID::fromAddr::READREPLY::value
-Message::Message(string message){
+// transID::fromAddr::READREPLY::value::timestamp
+// transID::fromAddr::DIGESTREPLY::digest::timestamp
+// transID::fromAddr::MULTIGET|MULTIPUT|MULTIREPLY|STREAM|STREAMACK|HINT|HINTACK::count then key::value::flag::timestamp per entry
+// transID::fromAddr::MERKLEDIGEST::rangeStart::rangeEnd::count then ::hash per leaf
+// A CREATE, READ, UPDATE, DELETE or READDIGEST with cancel hints ends with ::transID,transID,...
+//
+// Binary format (little endian, lengths are varints):
+// magic(1) type(1) transID(4) fromAddr(6) then
+// CREATE/UPDATE: replica(1) keylen key vallen value timestamp
+// READ/DELETE/READDIGEST: keylen key
+// REPLY:         success(1)
+// READREPLY:     vallen value timestamp
+// DIGESTREPLY:   digest(8) timestamp
+// MULTIGET, MULTIPUT, MULTIREPLY, STREAM, STREAMACK, HINT, HINTACK: count then flag(1) keylen key vallen value timestamp per entry
+// MERKLEDIGEST:  rangeStart(8) rangeEnd(8) count then hash(8) per leaf
+// A CREATE, READ, UPDATE, DELETE or READDIGEST with cancel hints ends with count then transID per hint
+Message::Message(string message): Message(message.data(), (int)message.size()) {}
+
+/**
+ * Constructor
+ */
+// construct a message straight from a receive buffer, without copying it into a string first
+Message::Message(const char *data, int size){
+	MessageView view;
 	this->delimiter = "::";
-	vector<string> tuple;
-	size_t pos = message.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = message.substr(start, pos-start);
-		tuple.push_back(field);
+	view.entries = &entries;
+	view.digest = &digest;
+	view.cancelled = &cancelled;
+	valid = decode(data, size, view);
+	transID = view.transID;
+	fromAddr = view.fromAddr;
+	type = view.type;
+	replica = view.replica;
+	success = view.success;
+	timestamp = view.timestamp;
+	key.assign(view.key.data(), view.key.size());
+	value.assign(view.value.data(), view.value.size());
+	rangeStart = view.rangeStart;
+	rangeEnd = view.rangeEnd;
+}
+
+/**
+ * FUNCTION NAME: parseInt
+ *
+ * DESCRIPTION: Parse a decimal field that is not NUL terminated
+ */
+static int parseInt(const char *field, int len) {
+	int i = 0, sign = 1, ret = 0;
+	if (len > 0 && field[0] == '-') {
+		sign = -1;
+		i++;
+	}
+	for (; i < len; i++) {
+		ret = ret * 10 + (field[i] - '0');
+	}
+	return sign * ret;
+}
+
+/**
+ * FUNCTION NAME: parseU64
+ *
+ * DESCRIPTION: Parse an unsigned 64-bit decimal field that is not NUL terminated
+ */
+static unsigned long long parseU64(const char *field, int len) {
+	unsigned long long ret = 0;
+	for (int i = 0; i < len; i++) {
+		ret = ret * 10 + (field[i] - '0');
+	}
+	return ret;
+}
+
+/**
+ * FUNCTION NAME: putVarint
+ *
+ * DESCRIPTION: Append an unsigned LEB128 varint to the buffer, return the new end
+ */
+static char *putVarint(char *out, unsigned int v) {
+	while (v >= 0x80) {
+		*out++ = (char)(v | 0x80);
+		v >>= 7;
+	}
+	*out++ = (char)v;
+	return out;
+}
+
+/**
+ * FUNCTION NAME: varintSize
+ *
+ * DESCRIPTION: Number of bytes putVarint writes for v
+ */
+static int varintSize(unsigned int v) {
+	int n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+/**
+ * FUNCTION NAME: getVarint
+ *
+ * DESCRIPTION: Read a varint, return NULL if it runs past end
+ */
+static const char *getVarint(const char *in, const char *end, unsigned int *v) {
+	unsigned int ret = 0;
+	int shift = 0;
+	while (in < end && shift < 35) {
+		unsigned char b = (unsigned char)*in++;
+		ret |= (unsigned int)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*v = ret;
+			return in;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+/**
+ * FUNCTION NAME: getBytes
+ *
+ * DESCRIPTION: Read a length prefixed byte string as a view into the buffer
+ */
+static const char *getBytes(const char *in, const char *end, string_view *field) {
+	unsigned int len;
+	in = getVarint(in, end, &len);
+	if (in == NULL || len > (unsigned int)(end - in)) {
+		return NULL;
+	}
+	*field = string_view(in, len);
+	return in + len;
+}
+
+/**
+ * FUNCTION NAME: getCancelled
+ *
+ * DESCRIPTION: Read the cancel hints that may end a binary request
+ */
+static const char *getCancelled(const char *in, const char *end, vector<int> *cancelled) {
+	if (in == NULL || in == end) {
+		return in;
+	}
+	unsigned int count;
+	in = getVarint(in, end, &count);
+	for (unsigned int i = 0; in != NULL && i < count; i++) {
+		unsigned int transID;
+		in = getVarint(in, end, &transID);
+		if (in != NULL && cancelled != NULL)
+			cancelled->push_back((int)transID);
+	}
+	return in;
+}
+
+/**
+ * FUNCTION NAME: parseCancelled
+ *
+ * DESCRIPTION: Parse the comma separated cancel hints that may end a text request
+ */
+static void parseCancelled(const char *field, int len, vector<int> *cancelled) {
+	if (cancelled == NULL) {
+		return;
+	}
+	const char *end = field + len;
+	while (field < end) {
+		const char *comma = find(field, end, ',');
+		cancelled->push_back(parseInt(field, comma - field));
+		field = comma == end ? end : comma + 1;
+	}
+}
+
+/**
+ * FUNCTION NAME: isRequest
+ *
+ * DESCRIPTION: Whether messages of this type can carry cancel hints
+ */
+bool Message::isRequest(MessageType type) {
+	return type == CREATE || type == READ || type == UPDATE || type == DELETE || type == READDIGEST;
+}
+
+/**
+ * FUNCTION NAME: peekHeader
+ *
+ * DESCRIPTION: Read the type and transID of a message without decoding the rest
+ *
+ * RETURNS:
+ * true if the buffer is long enough to hold them
+ */
+bool Message::peekHeader(const char *data, int size, MessageType *type, int *transID) {
+	if (size > 0 && (unsigned char)data[0] == BINARY_MAGIC) {
+		if (size < 2 + (int)sizeof(int)) {
+			return false;
+		}
+		*type = static_cast<MessageType>((unsigned char)data[1]);
+		memcpy(transID, data + 2, sizeof(int));
+		return true;
+	}
+	static const char delim[] = "::";
+	const char *end = data + size;
+	const char *first = search(data, end, delim, delim + 2);
+	const char *second = first == end ? end : search(first + 2, end, delim, delim + 2);
+	if (second == end) {
+		return false;
+	}
+	const char *third = search(second + 2, end, delim, delim + 2);
+	*transID = parseInt(data, first - data);
+	*type = static_cast<MessageType>(parseInt(second + 2, third - second - 2));
+	return true;
+}
+
+/**
+ * FUNCTION NAME: decode
+ *
+ * DESCRIPTION: Decode a message in either wire format. The key and value of the
+ * 				view point into data, which must outlive the view.
+ *
+ * RETURNS:
+ * true if the buffer held a well formed message
+ */
+bool Message::decode(const char *data, int size, MessageView &view) {
+	// A malformed buffer decodes as a reply to no transaction, which handlers ignore
+	view.type = REPLY;
+	view.transID = -1;
+	view.replica = PRIMARY;
+	view.success = false;
+	view.timestamp = 0;
+	view.key = string_view();
+	view.value = string_view();
+	view.rangeStart = 0;
+	view.rangeEnd = 0;
+	if (size > 0 && (unsigned char)data[0] == BINARY_MAGIC) {
+		return decodeBinary(data, size, view);
+	}
+	return decodeText(data, size, view);
+}
+
+/**
+ * FUNCTION NAME: decodeBinary
+ *
+ * DESCRIPTION: Decode the length prefixed binary format
+ */
+bool Message::decodeBinary(const char *data, int size, MessageView &view) {
+	const char *in = data;
+	const char *end = data + size;
+
+	if (size < 2 + (int)sizeof(int) + (int)sizeof(view.fromAddr.addr)) {
+		return false;
+	}
+	in++;
+	MessageType type = static_cast<MessageType>((unsigned char)*in++);
+	memcpy(&view.transID, in, sizeof(int));
+	in += sizeof(int);
+	memcpy(view.fromAddr.addr, in, sizeof(view.fromAddr.addr));
+	in += sizeof(view.fromAddr.addr);
+
+	view.type = type;
+	switch(view.type){
+		case CREATE:
+		case UPDATE:
+			if (in == end)
+				return false;
+			view.replica = static_cast<ReplicaType>((unsigned char)*in++);
+			in = getBytes(in, end, &view.key);
+			if (in != NULL)
+				in = getBytes(in, end, &view.value);
+			if (in != NULL)
+				in = getVarint(in, end, (unsigned int *)&view.timestamp);
+			in = getCancelled(in, end, view.cancelled);
+			break;
+		case READ:
+		case DELETE:
+		case READDIGEST:
+			in = getBytes(in, end, &view.key);
+			in = getCancelled(in, end, view.cancelled);
+			break;
+		case REPLY:
+			if (in == end)
+				return false;
+			view.success = (*in++ != 0);
+			break;
+		case READREPLY:
+			in = getBytes(in, end, &view.value);
+			if (in != NULL)
+				in = getVarint(in, end, (unsigned int *)&view.timestamp);
+			break;
+		case DIGESTREPLY: {
+			unsigned long long hash;
+			if (end - in < (int)sizeof(hash))
+				return false;
+			memcpy(&hash, in, sizeof(hash));
+			in += sizeof(hash);
+			if (view.digest != NULL)
+				view.digest->push_back(hash);
+			in = getVarint(in, end, (unsigned int *)&view.timestamp);
+			break;
+		}
+		case MULTIGET:
+		case MULTIPUT:
+		case MULTIREPLY:
+		case STREAM:
+		case STREAMACK:
+		case HINT:
+		case HINTACK: {
+			unsigned int count;
+			in = getVarint(in, end, &count);
+			for (unsigned int i = 0; in != NULL && i < count; i++) {
+				if (in == end)
+					return false;
+				int flag = (unsigned char)*in++;
+				string_view key, value;
+				unsigned int timestamp = 0;
+				in = getBytes(in, end, &key);
+				if (in != NULL)
+					in = getBytes(in, end, &value);
+				if (in != NULL)
+					in = getVarint(in, end, &timestamp);
+				if (in != NULL && view.entries != NULL)
+					view.entries->push_back({string(key), string(value), flag, (int)timestamp});
+			}
+			break;
+		}
+		case MERKLEDIGEST: {
+			unsigned long long range[2];
+			if (end - in < (int)sizeof(range))
+				return false;
+			memcpy(range, in, sizeof(range));
+			in += sizeof(range);
+			view.rangeStart = range[0];
+			view.rangeEnd = range[1];
+			unsigned int count;
+			in = getVarint(in, end, &count);
+			if (in == NULL || count > (unsigned int)(end - in) / sizeof(unsigned long long))
+				return false;
+			for (unsigned int i = 0; i < count; i++) {
+				unsigned long long hash;
+				memcpy(&hash, in, sizeof(hash));
+				in += sizeof(hash);
+				if (view.digest != NULL)
+					view.digest->push_back(hash);
+			}
+			break;
+		}
+		default:
+			return false;
+	}
+	return in != NULL;
+}
+
+/**
+ * FUNCTION NAME: decodeText
+ *
+ * DESCRIPTION: Decode the "::" delimited text format
+ */
+bool Message::decodeText(const char *data, int size, MessageView &view) {
+	static const char delim[] = "::";
+	const char *end = data + size;
+	const char *start = data;
+	const char *field[8];
+	int len[8];
+	int n = 0;
+	while (n < 7) {
+		const char *pos = search(start, end, delim, delim + 2);
+		if (pos == end)
+			break;
+		field[n] = start;
+		len[n++] = pos - start;
 		start = pos + 2;
-		pos = message.find(delimiter, start);
 	}
-	tuple.push_back(message.substr(start));
+	field[n] = start;
+	len[n++] = end - start;
+	if (n < 3) {
+		return false;
+	}
 
-	transID = stoi(tuple.at(0));
-	Address addr(tuple.at(1));
-	fromAddr = addr;
-	type = static_cast<MessageType>(stoi(tuple.at(2)));
-	switch(type){
+	view.transID = parseInt(field[0], len[0]);
+	const char *colon = (const char *)memchr(field[1], ':', len[1]);
+	if (colon == NULL) {
+		return false;
+	}
+	int id = parseInt(field[1], colon - field[1]);
+	short port = (short)parseInt(colon + 1, field[1] + len[1] - colon - 1);
+	memcpy(&view.fromAddr.addr[0], &id, sizeof(int));
+	memcpy(&view.fromAddr.addr[4], &port, sizeof(short));
+	view.type = static_cast<MessageType>(parseInt(field[2], len[2]));
+	switch(view.type){
 		case CREATE:
 		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+			if (n < 5)
+				return false;
+			view.key = string_view(field[3], len[3]);
+			view.value = string_view(field[4], len[4]);
+			if (n > 5)
+				view.replica = static_cast<ReplicaType>(parseInt(field[5], len[5]));
+			if (n > 6)
+				view.timestamp = parseInt(field[6], len[6]);
+			if (n > 7)
+				parseCancelled(field[7], len[7], view.cancelled);
 			break;
 		case READ:
 		case DELETE:
-			key = tuple.at(3);
+		case READDIGEST:
+			if (n < 4)
+				return false;
+			view.key = string_view(field[3], len[3]);
+			if (n > 4)
+				parseCancelled(field[4], len[4], view.cancelled);
 			break;
 		case REPLY:
-			if (tuple.at(3) == "1")
-				success = true;
-			else
-				success = false;
+			if (n < 4)
+				return false;
+			view.success = (len[3] == 1 && field[3][0] == '1');
 			break;
 		case READREPLY:
-			value = tuple.at(3);
+			if (n < 4)
+				return false;
+			view.value = string_view(field[3], len[3]);
+			if (n > 4)
+				view.timestamp = parseInt(field[4], len[4]);
+			break;
+		case DIGESTREPLY:
+			if (n < 5)
+				return false;
+			if (view.digest != NULL)
+				view.digest->push_back(parseU64(field[3], len[3]));
+			view.timestamp = parseInt(field[4], len[4]);
+			break;
+		case MULTIGET:
+		case MULTIPUT:
+		case MULTIREPLY:
+		case STREAM:
+		case STREAMACK:
+		case HINT:
+		case HINTACK: {
+			if (n < 4)
+				return false;
+			// The fields split above stop after six delimiters; split the entries from field 3 on
+			const char *next[4];
+			int nextLen[4];
+			const char *pos = search(field[3], end, delim, delim + 2);
+			int count = parseInt(field[3], pos - field[3]);
+			for (int i = 0; i < count; i++) {
+				for (int f = 0; f < 4; f++) {
+					if (pos == end)
+						return false;
+					next[f] = pos + 2;
+					pos = search(next[f], end, delim, delim + 2);
+					nextLen[f] = pos - next[f];
+				}
+				if (view.entries != NULL)
+					view.entries->push_back({string(next[0], nextLen[0]), string(next[1], nextLen[1]), parseInt(next[2], nextLen[2]), parseInt(next[3], nextLen[3])});
+			}
 			break;
+		}
+		case MERKLEDIGEST: {
+			if (n < 6)
+				return false;
+			view.rangeStart = parseU64(field[3], len[3]);
+			view.rangeEnd = parseU64(field[4], len[4]);
+			const char *pos = search(field[5], end, delim, delim + 2);
+			int count = parseInt(field[5], pos - field[5]);
+			for (int i = 0; i < count; i++) {
+				if (pos == end)
+					return false;
+				const char *hash = pos + 2;
+				pos = search(hash, end, delim, delim + 2);
+				if (view.digest != NULL)
+					view.digest->push_back(parseU64(hash, pos - hash));
+			}
+			break;
+		}
+		default:
+			return false;
 	}
+	return true;
 }
 
 /**
@@ -61,6 +496,7 @@ Message::Message(string message){
 // construct a create or update message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -69,6 +505,34 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 	replica = _replica;
 }
 
+/**
+ * Constructor
+ */
+// construct a batched message
+Message::Message(int _transID, Address _fromAddr, MessageType _type, const vector<BatchEntry> &_entries){
+	this->delimiter = "::";
+	timestamp = 0;
+	transID = _transID;
+	fromAddr = _fromAddr;
+	type = _type;
+	entries = _entries;
+}
+
+/**
+ * Constructor
+ */
+// construct a Merkle digest message
+Message::Message(Address _fromAddr, size_t _rangeStart, size_t _rangeEnd, const vector<unsigned long long> &_digest){
+	this->delimiter = "::";
+	timestamp = 0;
+	transID = -1;
+	fromAddr = _fromAddr;
+	type = MERKLEDIGEST;
+	rangeStart = _rangeStart;
+	rangeEnd = _rangeEnd;
+	digest = _digest;
+}
+
 /**
  * Constructor
  */
@@ -78,9 +542,16 @@ Message::Message(const Message& anotherMessage) {
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
+	this->entries = anotherMessage.entries;
+	this->rangeStart = anotherMessage.rangeStart;
+	this->rangeEnd = anotherMessage.rangeEnd;
+	this->digest = anotherMessage.digest;
+	this->cancelled = anotherMessage.cancelled;
+	this->valid = anotherMessage.valid;
 }
 
 /**
@@ -88,6 +559,7 @@ Message::Message(const Message& anotherMessage) {
  */
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -101,6 +573,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct a read or delete message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -113,6 +586,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -125,12 +599,26 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
 // construct read reply message
 Message::Message(int _transID, Address _fromAddr, string _value){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
 	value = _value;
 }
 
+/**
+ * Constructor
+ */
+// construct digest reply message
+Message::Message(int _transID, Address _fromAddr, unsigned long long _digest, int _timestamp){
+	this->delimiter = "::";
+	timestamp = _timestamp;
+	transID = _transID;
+	fromAddr = _fromAddr;
+	type = DIGESTREPLY;
+	digest.assign(1, _digest);
+}
+
 /**
  * FUNCTION NAME: toString
  *
@@ -141,10 +629,11 @@ string Message::toString(){
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			message += key + delimiter + value + delimiter + to_string(replica);
+			message += key + delimiter + value + delimiter + to_string(replica) + delimiter + to_string(timestamp);
 			break;
 		case READ:
 		case DELETE:
+		case READDIGEST:
 			message += key;
 			break;
 		case REPLY:
@@ -154,12 +643,192 @@ string Message::toString(){
 				message += "0";
 			break;
 		case READREPLY:
-			message += value;
+			message += value + delimiter + to_string(timestamp);
+			break;
+		case DIGESTREPLY:
+			message += to_string(digest[0]) + delimiter + to_string(timestamp);
+			break;
+		case MULTIGET:
+		case MULTIPUT:
+		case MULTIREPLY:
+		case STREAM:
+		case STREAMACK:
+		case HINT:
+		case HINTACK:
+			message += to_string(entries.size());
+			for (const BatchEntry &entry : entries) {
+				message += delimiter + entry.key + delimiter + entry.value + delimiter + to_string(entry.flag) + delimiter + to_string(entry.timestamp);
+			}
 			break;
+		case MERKLEDIGEST:
+			message += to_string(rangeStart) + delimiter + to_string(rangeEnd) + delimiter + to_string(digest.size());
+			for (unsigned long long hash : digest) {
+				message += delimiter + to_string(hash);
+			}
+			break;
+	}
+	if (isRequest(type) && !cancelled.empty()) {
+		message += delimiter;
+		for (size_t i = 0; i < cancelled.size(); i++) {
+			message += (i ? "," : "") + to_string(cancelled[i]);
+		}
 	}
 	return message;
 }
 
+/**
+ * FUNCTION NAME: toBinary
+ *
+ * DESCRIPTION: Serialize Message in the length prefixed binary format.
+ * 				The exact size is computed first so the output is written in one pass.
+ */
+string Message::toBinary(){
+	size_t size = 2 + sizeof(int) + sizeof(fromAddr.addr);
+	switch(type){
+		case CREATE:
+		case UPDATE:
+			size += 1 + varintSize(key.size()) + key.size() + varintSize(value.size()) + value.size() + varintSize(timestamp);
+			break;
+		case READ:
+		case DELETE:
+		case READDIGEST:
+			size += varintSize(key.size()) + key.size();
+			break;
+		case REPLY:
+			size += 1;
+			break;
+		case READREPLY:
+			size += varintSize(value.size()) + value.size() + varintSize(timestamp);
+			break;
+		case DIGESTREPLY:
+			size += sizeof(unsigned long long) + varintSize(timestamp);
+			break;
+		case MULTIGET:
+		case MULTIPUT:
+		case MULTIREPLY:
+		case STREAM:
+		case STREAMACK:
+		case HINT:
+		case HINTACK:
+			size += varintSize(entries.size());
+			for (const BatchEntry &entry : entries) {
+				size += 1 + varintSize(entry.key.size()) + entry.key.size() + varintSize(entry.value.size()) + entry.value.size() + varintSize(entry.timestamp);
+			}
+			break;
+		case MERKLEDIGEST:
+			size += 2 * sizeof(unsigned long long) + varintSize(digest.size()) + digest.size() * sizeof(unsigned long long);
+			break;
+	}
+	bool hints = isRequest(type) && !cancelled.empty();
+	if (hints) {
+		size += varintSize(cancelled.size());
+		for (int id : cancelled) {
+			size += varintSize(id);
+		}
+	}
+
+	string message(size, '\0');
+	char *out = &message[0];
+	*out++ = (char)BINARY_MAGIC;
+	*out++ = (char)type;
+	memcpy(out, &transID, sizeof(int));
+	out += sizeof(int);
+	memcpy(out, fromAddr.addr, sizeof(fromAddr.addr));
+	out += sizeof(fromAddr.addr);
+	switch(type){
+		case CREATE:
+		case UPDATE:
+			*out++ = (char)replica;
+			out = putVarint(out, key.size());
+			memcpy(out, key.data(), key.size());
+			out += key.size();
+			out = putVarint(out, value.size());
+			memcpy(out, value.data(), value.size());
+			out += value.size();
+			out = putVarint(out, timestamp);
+			break;
+		case READ:
+		case DELETE:
+		case READDIGEST:
+			out = putVarint(out, key.size());
+			memcpy(out, key.data(), key.size());
+			out += key.size();
+			break;
+		case REPLY:
+			*out = success ? 1 : 0;
+			break;
+		case READREPLY:
+			out = putVarint(out, value.size());
+			memcpy(out, value.data(), value.size());
+			out += value.size();
+			out = putVarint(out, timestamp);
+			break;
+		case DIGESTREPLY:
+			memcpy(out, &digest[0], sizeof(unsigned long long));
+			out += sizeof(unsigned long long);
+			out = putVarint(out, timestamp);
+			break;
+		case MULTIGET:
+		case MULTIPUT:
+		case MULTIREPLY:
+		case STREAM:
+		case STREAMACK:
+		case HINT:
+		case HINTACK:
+			out = putVarint(out, entries.size());
+			for (const BatchEntry &entry : entries) {
+				*out++ = (char)entry.flag;
+				out = putVarint(out, entry.key.size());
+				memcpy(out, entry.key.data(), entry.key.size());
+				out += entry.key.size();
+				out = putVarint(out, entry.value.size());
+				memcpy(out, entry.value.data(), entry.value.size());
+				out += entry.value.size();
+				out = putVarint(out, entry.timestamp);
+			}
+			break;
+		case MERKLEDIGEST: {
+			unsigned long long range[2] = {rangeStart, rangeEnd};
+			memcpy(out, range, sizeof(range));
+			out += sizeof(range);
+			out = putVarint(out, digest.size());
+			memcpy(out, digest.data(), digest.size() * sizeof(unsigned long long));
+			break;
+		}
+	}
+	if (hints) {
+		out = putVarint(out, cancelled.size());
+		for (int id : cancelled) {
+			out = putVarint(out, id);
+		}
+	}
+	return message;
+}
+
+/**
+ * FUNCTION NAME: entryWireSize
+ *
+ * DESCRIPTION: Upper bound of the bytes one entry adds to a batched message in either
+ * 				wire format, used to split batches under the maximum message size
+ */
+size_t Message::entryWireSize(const BatchEntry &entry){
+	// binary: flag and three varints of at most 5 bytes; text: four "::", the flag and the timestamp
+	return entry.key.size() + entry.value.size() + 24;
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Serialize Message in the wire format selected in common.h
+ */
+string Message::encode(){
+#ifdef TEXT_WIRE_FORMAT
+	return toString();
+#else
+	return toBinary();
+#endif
+}
+
 /**
  * Assignment operator overloading
  */
@@ -169,8 +838,15 @@ Message& Message::operator =(const Message& anotherMessage) {
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
+	this->entries = anotherMessage.entries;
+	this->rangeStart = anotherMessage.rangeStart;
+	this->rangeEnd = anotherMessage.rangeEnd;
+	this->digest = anotherMessage.digest;
+	this->cancelled = anotherMessage.cancelled;
+	this->valid = anotherMessage.valid;
 	return *this;
 }
@@ -10,6 +10,51 @@
 #include "Member.h"
 #include "common.h"
 
+// First byte of a binary message; never a digit or '-', so it tells the formats apart
+#define BINARY_MAGIC 0xC3
+// Upper bound of the header of a batched message in either wire format
+#define BATCH_HEADER_MAX 64
+
+/**
+ * STRUCT NAME: BatchEntry
+ *
+ * DESCRIPTION: One key of a batched message. flag is the ReplicaType of the key
+ * 				in a MULTIPUT, STREAM or HINT and its success (0 or 1) in a MULTIREPLY,
+ * 				STREAMACK or HINTACK.
+ */
+struct BatchEntry {
+	string key;
+	string value;
+	int flag;
+	// version of the value, the coordinator time of the write
+	int timestamp;
+};
+
+/**
+ * STRUCT NAME: MessageView
+ *
+ * DESCRIPTION: A decoded message whose key and value point into the receive buffer
+ */
+struct MessageView {
+	MessageType type;
+	ReplicaType replica;
+	int transID;
+	Address fromAddr;
+	bool success;
+	string_view key;
+	string_view value;
+	int timestamp;
+	// where the entries of a batched message are decoded to, if anywhere
+	vector<BatchEntry> *entries = NULL;
+	// token range and where the leaf hashes of a MERKLEDIGEST, or the value digest
+	// of a DIGESTREPLY, are decoded to
+	size_t rangeStart;
+	size_t rangeEnd;
+	vector<unsigned long long> *digest = NULL;
+	// where the cancel hints of a request are decoded to, if anywhere
+	vector<int> *cancelled = NULL;
+};
+
 /**
  * CLASS NAME: Message
  *
@@ -24,10 +69,27 @@ public:
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
+	// version of the value of a CREATE, UPDATE, READREPLY or DIGESTREPLY
+	int timestamp;
+	// keys of a MULTIGET, MULTIPUT, MULTIREPLY, STREAM, STREAMACK, HINT or HINTACK
+	vector<BatchEntry> entries;
+	// token range (rangeStart, rangeEnd] and Merkle leaf hashes of a MERKLEDIGEST,
+	// or the single value digest of a DIGESTREPLY
+	size_t rangeStart;
+	size_t rangeEnd;
+	vector<unsigned long long> digest;
+	// transactions of the sender that have finished, piggybacked on a CREATE, READ,
+	// UPDATE, DELETE or READDIGEST so that the receiver can skip work queued for them
+	vector<int> cancelled;
+	// false if the buffer the message was constructed from did not decode in full;
+	// such a message is dropped
+	bool valid = true;
 	// delimiter
 	string delimiter;
 	// construct a message from a string
 	Message(string message);
+	// construct a message from a receive buffer
+	Message(const char *data, int size);
 	Message(const Message& anotherMessage);
 	// construct a create or update message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
@@ -38,9 +100,29 @@ public:
 	Message(int _transID, Address _fromAddr, MessageType _type, bool _success);
 	// construct read reply message
 	Message(int _transID, Address _fromAddr, string _value);
+	// construct digest reply message
+	Message(int _transID, Address _fromAddr, unsigned long long _digest, int _timestamp);
+	// construct a batched message
+	Message(int _transID, Address _fromAddr, MessageType _type, const vector<BatchEntry> &_entries);
+	// construct a Merkle digest message
+	Message(Address _fromAddr, size_t _rangeStart, size_t _rangeEnd, const vector<unsigned long long> &_digest);
 	Message& operator = (const Message& anotherMessage);
 	// serialize to a string
 	string toString();
+	// serialize to the binary format
+	string toBinary();
+	// serialize to the wire format in use
+	string encode();
+	// decode either wire format without copying key or value
+	static bool decode(const char *data, int size, MessageView &view);
+	static bool decodeBinary(const char *data, int size, MessageView &view);
+	static bool decodeText(const char *data, int size, MessageView &view);
+	// read only the type and transID of a message in either wire format
+	static bool peekHeader(const char *data, int size, MessageType *type, int *transID);
+	// whether messages of this type can carry cancel hints
+	static bool isRequest(MessageType type);
+	// bytes one entry adds to a batched message, in either wire format
+	static size_t entryWireSize(const BatchEntry &entry);
 };
 
 #endif
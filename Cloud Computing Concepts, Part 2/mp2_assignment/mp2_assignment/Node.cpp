@@ -9,12 +9,22 @@
 /**
  * constructor
  */
-Node::Node() {}
+Node::Node(): vnode(0) {}
 
 /**
  * constructor
  */
-Node::Node(Address address) {
+Node::Node(Address address): vnode(0) {
+	this->nodeAddress = address;
+	computeHashCode();
+}
+
+/**
+ * constructor
+ *
+ * DESCRIPTION: Token number vnode of the node at address
+ */
+Node::Node(Address address, int vnode): vnode(vnode) {
 	this->nodeAddress = address;
 	computeHashCode();
 }
@@ -27,10 +37,11 @@ Node::~Node() {}
 /**
  * FUNCTION NAME: computeHashCode
  *
- * DESCRIPTION: This function computes the hash code of the node address
+ * DESCRIPTION: This function computes the hash code of the node address, the
+ * 				ring position the partitioner gives this token of the node
  */
 void Node::computeHashCode() {
-	nodeHashCode = hashFunc(nodeAddress.addr)%RING_SIZE;
+	nodeHashCode = Partitioner::tokenPosition(nodeAddress, vnode);
 }
 
 /**
@@ -39,6 +50,7 @@ void Node::computeHashCode() {
 Node::Node(const Node& another) {
 	this->nodeAddress = another.nodeAddress;
 	this->nodeHashCode = another.nodeHashCode;
+	this->vnode = another.vnode;
 }
 
 /**
@@ -47,6 +59,7 @@ Node::Node(const Node& another) {
 Node& Node::operator=(const Node& another) {
 	this->nodeAddress = another.nodeAddress;
 	this->nodeHashCode = another.nodeHashCode;
+	this->vnode = another.vnode;
 	return *this;
 }
 
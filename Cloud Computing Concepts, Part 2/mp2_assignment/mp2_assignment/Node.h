@@ -9,14 +9,17 @@
 
 #include "stdincludes.h"
 #include "Member.h"
+#include "Partitioner.h"
 
 class Node {
 public:
 	Address nodeAddress;
 	size_t nodeHashCode;
-	std::hash<string> hashFunc;
+	// which of the node's tokens (virtual nodes) this is
+	int vnode;
 	Node();
 	Node(Address address);
+	Node(Address address, int vnode);
 	Node(const Node& another);
 	Node& operator=(const Node& another);
 	bool operator < (const Node& another) const;
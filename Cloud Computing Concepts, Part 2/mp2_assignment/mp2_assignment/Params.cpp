@@ -5,6 +5,7 @@
  **********************************/
 
 #include "Params.h"
+#include "common.h"
 
 /**
  * Constructor
@@ -19,6 +20,11 @@ Params::Params(): PORTNUM(8001) {}
 void Params::setparams(char *config_file) {
 	//trace.funcEntry("Params::setparams");
 	char CRUD[10];
+	char partitioner[10];
+	char consistency[10];
+	char readMode[10];
+	char gossipMode[10];
+	char detector[10];
 	FILE *fp = fopen(config_file,"r");
 
 	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
@@ -27,6 +33,48 @@ void Params::setparams(char *config_file) {
 	fscanf(fp,"\nMSG_DROP_PROB: %lf", &MSG_DROP_PROB);
 	fscanf(fp,"\nCRUD_TEST: %s", CRUD);
 
+	// Optional settings: they must appear in this order, and defaults apply
+	// to any a test case leaves out
+	VNODES = 1;
+	fscanf(fp,"\nVNODES: %d", &VNODES);
+	if ( VNODES < 1 ) {
+		VNODES = 1;
+	}
+	PARTITIONER = PARTITIONER_HASH64;
+	if ( 1 == fscanf(fp,"\nPARTITIONER: %9s", partitioner) && 0 == strcmp(partitioner, "COMPAT") ) {
+		PARTITIONER = PARTITIONER_COMPAT;
+	}
+	CONSISTENCY = QUORUM;
+	if ( 1 == fscanf(fp,"\nCONSISTENCY: %9s", consistency) ) {
+		if ( 0 == strcmp(consistency, "ONE") ) {
+			CONSISTENCY = ONE;
+		}
+		else if ( 0 == strcmp(consistency, "ALL") ) {
+			CONSISTENCY = ALL;
+		}
+	}
+	BATCH_SIZE = 0;
+	fscanf(fp,"\nBATCH_SIZE: %d", &BATCH_SIZE);
+	READ_MODE = READ_FULL;
+	if ( 1 == fscanf(fp,"\nREAD_MODE: %9s", readMode) ) {
+		if ( 0 == strcmp(readMode, "DIGEST") ) {
+			READ_MODE = READ_DIGEST;
+		}
+		else if ( 0 == strcmp(readMode, "HEDGED") ) {
+			READ_MODE = READ_HEDGED;
+		}
+	}
+	HEDGE_DELAY = 2;
+	fscanf(fp,"\nHEDGE_DELAY: %d", &HEDGE_DELAY);
+	GOSSIP_MODE = GOSSIP_FULL;
+	if ( 1 == fscanf(fp,"\nGOSSIP: %9s", gossipMode) && 0 == strcmp(gossipMode, "DELTA") ) {
+		GOSSIP_MODE = GOSSIP_DELTA;
+	}
+	DETECTOR = DETECTOR_GOSSIP;
+	if ( 1 == fscanf(fp,"\nDETECTOR: %9s", detector) && 0 == strcmp(detector, "SWIM") ) {
+		DETECTOR = DETECTOR_SWIM;
+	}
+
 	if ( 0 == strcmp(CRUD, "CREATE") ) {
 		this->CRUDTEST = CREATE_TEST;
 	}
@@ -10,8 +10,13 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Partitioner.h"
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
+// what a GOSSIP message carries: the whole membership list, or only the entries that changed
+enum GossipMode { GOSSIP_FULL, GOSSIP_DELTA };
+// how members find out about failures: heartbeats spread by gossip, or SWIM probes
+enum FailureDetector { DETECTOR_GOSSIP, DETECTOR_SWIM };
 
 /**
  * CLASS NAME: Params
@@ -32,6 +37,14 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int VNODES;					// tokens owned by every node on the ring
+	int PARTITIONER;			// PartitionerType placing keys and tokens on the ring
+	int CONSISTENCY;			// ConsistencyLevel of the requests the test driver sends
+	int BATCH_SIZE;				// keys per clientMultiPut when loading test keys, 0 for one by one
+	int READ_MODE;				// ReadMode of clientRead
+	int HEDGE_DELAY;			// ticks a hedged read waits for its quorum before asking the other replicas
+	int GOSSIP_MODE;			// GossipMode of the membership protocol
+	int DETECTOR;				// FailureDetector of the membership protocol
 	Params();
 	void setparams(char *);
 	int getcurrtime();
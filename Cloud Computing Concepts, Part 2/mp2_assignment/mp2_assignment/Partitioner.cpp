@@ -0,0 +1,168 @@
+/**********************************
+ * FILE NAME: Partitioner.cpp
+ *
+ * DESCRIPTION: Partitioner class definition
+ **********************************/
+
+#include "Partitioner.h"
+
+/*
+ * xxHash64 primes
+ */
+#define XXH_PRIME64_1 11400714785074694791ULL
+#define XXH_PRIME64_2 14029467366897019727ULL
+#define XXH_PRIME64_3 1609587929392839161ULL
+#define XXH_PRIME64_4 9650029242287828579ULL
+#define XXH_PRIME64_5 2870177450012600261ULL
+
+PartitionerType Partitioner::mode = PARTITIONER_HASH64;
+
+static inline unsigned long long rotl64(unsigned long long x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long read64(const char *p) {
+	unsigned long long v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned int read32(const char *p) {
+	unsigned int v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned long long xxhRound(unsigned long long acc, unsigned long long input) {
+	acc += input * XXH_PRIME64_2;
+	acc = rotl64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline unsigned long long xxhMerge(unsigned long long acc, unsigned long long val) {
+	acc ^= xxhRound(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/**
+ * FUNCTION NAME: xxh64
+ *
+ * DESCRIPTION: XXH64 of len bytes at data (little endian reads, as on the hosts we run on)
+ */
+unsigned long long Partitioner::xxh64(const char *data, size_t len, unsigned long long seed) {
+	const char *p = data;
+	const char *end = data + len;
+	unsigned long long h;
+
+	if ( len >= 32 ) {
+		unsigned long long v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		unsigned long long v2 = seed + XXH_PRIME64_2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - XXH_PRIME64_1;
+		do {
+			v1 = xxhRound(v1, read64(p));
+			v2 = xxhRound(v2, read64(p + 8));
+			v3 = xxhRound(v3, read64(p + 16));
+			v4 = xxhRound(v4, read64(p + 24));
+			p += 32;
+		} while ( p + 32 <= end );
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = xxhMerge(h, v1);
+		h = xxhMerge(h, v2);
+		h = xxhMerge(h, v3);
+		h = xxhMerge(h, v4);
+	}
+	else {
+		h = seed + XXH_PRIME64_5;
+	}
+	h += len;
+
+	while ( p + 8 <= end ) {
+		h ^= xxhRound(0, read64(p));
+		h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		p += 8;
+	}
+	if ( p + 4 <= end ) {
+		h ^= (unsigned long long)read32(p) * XXH_PRIME64_1;
+		h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	while ( p < end ) {
+		h ^= (unsigned char)*p * XXH_PRIME64_5;
+		h = rotl64(h, 11) * XXH_PRIME64_1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+/**
+ * FUNCTION NAME: keyPosition
+ *
+ * DESCRIPTION: Ring position of a key
+ */
+size_t Partitioner::keyPosition(const string &key) {
+	if ( mode == PARTITIONER_COMPAT ) {
+		std::hash<string> hashFunc;
+		return hashFunc(key)%RING_SIZE;
+	}
+	return xxh64(key.data(), key.size(), 0);
+}
+
+/**
+ * FUNCTION NAME: tokenPosition
+ *
+ * DESCRIPTION: Ring position of token vnode of the node at address.
+ * 				In compatibility mode token 0 hashes the address as a C string, the
+ * 				way the original ring did (so only the bytes before the first NUL
+ * 				count); the 64-bit mode hashes all 6 address bytes seeded by vnode.
+ */
+size_t Partitioner::tokenPosition(const Address &address, int vnode) {
+	if ( mode == PARTITIONER_COMPAT ) {
+		std::hash<string> hashFunc;
+		if ( vnode == 0 ) {
+			return hashFunc(string(address.addr, strnlen(address.addr, sizeof(address.addr))))%RING_SIZE;
+		}
+		return hashFunc(string(address.addr, sizeof(address.addr)) + "#" + to_string(vnode))%RING_SIZE;
+	}
+	return xxh64(address.addr, sizeof(address.addr), vnode);
+}
+
+/**
+ * FUNCTION NAME: distance
+ *
+ * DESCRIPTION: Fraction of the ring from position from clockwise to position to
+ */
+double Partitioner::distance(size_t from, size_t to) {
+	if ( mode == PARTITIONER_COMPAT ) {
+		return (double)((to + RING_SIZE - from) % RING_SIZE) / RING_SIZE;
+	}
+	// unsigned arithmetic wraps around the 2^64 ring by itself
+	return (double)(unsigned long long)(to - from) / 18446744073709551616.0;
+}
+
+/**
+ * FUNCTION NAME: offset
+ *
+ * DESCRIPTION: Number of ring positions from position from clockwise to position to
+ */
+size_t Partitioner::offset(size_t from, size_t to) {
+	if ( mode == PARTITIONER_COMPAT ) {
+		return (to + RING_SIZE - from) % RING_SIZE;
+	}
+	return to - from;
+}
+
+/**
+ * FUNCTION NAME: name
+ *
+ * DESCRIPTION: Name of the current mode as written in test cases
+ */
+const char *Partitioner::name() {
+	return (mode == PARTITIONER_COMPAT) ? "COMPAT" : "HASH64";
+}
@@ -0,0 +1,41 @@
+/**********************************
+ * FILE NAME: Partitioner.h
+ *
+ * DESCRIPTION: Header file Partitioner class
+ **********************************/
+
+#ifndef PARTITIONER_H_
+#define PARTITIONER_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+
+/*
+ * Partitioner modes
+ */
+enum PartitionerType {
+	// std::hash modulo RING_SIZE, the original 512 position ring
+	PARTITIONER_COMPAT,
+	// xxHash64 over the whole 64-bit ring space
+	PARTITIONER_HASH64
+};
+
+/**
+ * CLASS NAME: Partitioner
+ *
+ * DESCRIPTION: Maps keys and node tokens to positions on the ring. Every node
+ * 				must use the same mode, so it is process wide and set once from
+ * 				the test case before the nodes start.
+ */
+class Partitioner {
+public:
+	static PartitionerType mode;
+	static size_t keyPosition(const string &key);
+	static size_t tokenPosition(const Address &address, int vnode);
+	static double distance(size_t from, size_t to);
+	static size_t offset(size_t from, size_t to);
+	static const char *name();
+	static unsigned long long xxh64(const char *data, size_t len, unsigned long long seed);
+};
+
+#endif /* PARTITIONER_H_ */
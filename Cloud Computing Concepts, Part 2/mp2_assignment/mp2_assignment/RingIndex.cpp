@@ -0,0 +1,129 @@
+/**********************************
+ * FILE NAME: RingIndex.cpp
+ *
+ * DESCRIPTION: RingIndex class definition
+ **********************************/
+
+#include "RingIndex.h"
+
+/**
+ * constructor
+ */
+RingIndex::RingIndex(): version(0), physicalNodes(0) {}
+
+/**
+ * Destructor
+ */
+RingIndex::~RingIndex() {}
+
+/**
+ * FUNCTION NAME: build
+ *
+ * DESCRIPTION: Build this ring version from nodes already sorted by token and
+ * 				memoize the preference list of every range
+ */
+void RingIndex::build(const vector<Node> &sortedNodes, int version) {
+	this->version = version;
+	nodes = sortedNodes;
+	tokens.clear();
+	preferenceLists.clear();
+	tokens.reserve(nodes.size());
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		tokens.push_back(nodes[i].getHashCode());
+	}
+
+	vector<unsigned long long> physical;
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		physical.push_back(nodes[i].nodeAddress.pack());
+	}
+	sort(physical.begin(), physical.end());
+	physicalNodes = unique(physical.begin(), physical.end()) - physical.begin();
+
+	// Fewer nodes than replicas: no range has a complete preference list
+	if ( physicalNodes < NUM_REPLICAS ) {
+		return;
+	}
+	// Walk clockwise from each token, skipping further tokens of nodes already chosen
+	preferenceLists.resize(nodes.size());
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		for ( size_t j = i; preferenceLists[i].size() < NUM_REPLICAS; j = (j + 1) % nodes.size() ) {
+			bool chosen = false;
+			for ( Node &replica : preferenceLists[i] ) {
+				if ( replica.nodeAddress == nodes[j].nodeAddress ) {
+					chosen = true;
+					break;
+				}
+			}
+			if ( !chosen ) {
+				preferenceLists[i].emplace_back(nodes[j]);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Number of tokens on the ring
+ */
+size_t RingIndex::size() {
+	return tokens.size();
+}
+
+/**
+ * FUNCTION NAME: rangeOf
+ *
+ * DESCRIPTION: Index of the range holding ring position pos: the first token at
+ * 				or clockwise of pos, wrapping to range 0 past the last token
+ */
+int RingIndex::rangeOf(size_t pos) {
+	vector<size_t>::iterator it = lower_bound(tokens.begin(), tokens.end(), pos);
+	if ( it == tokens.end() ) {
+		return 0;
+	}
+	return (int)(it - tokens.begin());
+}
+
+/**
+ * FUNCTION NAME: findNodes
+ *
+ * DESCRIPTION: Replicas of ring position pos, empty while the ring is too small
+ */
+vector<Node> &RingIndex::findNodes(size_t pos) {
+	static vector<Node> none;
+	if ( preferenceLists.empty() ) {
+		return none;
+	}
+	return preferenceLists[rangeOf(pos)];
+}
+
+/**
+ * FUNCTION NAME: rangeShare
+ *
+ * DESCRIPTION: Fraction of the ring covered by range i
+ */
+double RingIndex::rangeShare(int range) {
+	if ( tokens.size() < 2 ) {
+		return 1.0;
+	}
+	size_t last = (range == 0) ? tokens.back() : tokens[range - 1];
+	return Partitioner::distance(last, tokens[range]);
+}
+
+/**
+ * FUNCTION NAME: loadShare
+ *
+ * DESCRIPTION: Share of the ring every physical node (keyed by packed address) owns
+ * 				as primary, and the share of all replicas it holds
+ */
+void RingIndex::loadShare(map<unsigned long long, double> &primaryShare, map<unsigned long long, double> &replicaShare) {
+	primaryShare.clear();
+	replicaShare.clear();
+	for ( size_t i = 0; i < preferenceLists.size(); i++ ) {
+		double share = rangeShare(i);
+		primaryShare[preferenceLists[i][0].nodeAddress.pack()] += share;
+		for ( Node &replica : preferenceLists[i] ) {
+			replicaShare[replica.nodeAddress.pack()] += share / NUM_REPLICAS;
+		}
+	}
+}
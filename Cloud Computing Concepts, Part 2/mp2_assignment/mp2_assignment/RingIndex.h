@@ -0,0 +1,52 @@
+/**********************************
+ * FILE NAME: RingIndex.h
+ *
+ * DESCRIPTION: Header file RingIndex class
+ **********************************/
+
+#ifndef RINGINDEX_H_
+#define RINGINDEX_H_
+
+#include "stdincludes.h"
+#include "Node.h"
+
+/*
+ * Macros
+ */
+// number of replicas of every key
+#define NUM_REPLICAS 3
+
+/**
+ * CLASS NAME: RingIndex
+ *
+ * DESCRIPTION: One version of the consistent hashing ring. The tokens of the
+ * 				nodes are kept sorted in a contiguous array for binary search, and
+ * 				the preference list of every token range is computed once when the
+ * 				version is built, so a lookup is O(log n) and allocates nothing.
+ * 				Range i is (tokens[i-1], tokens[i]], wrapping around at range 0.
+ * 				A physical node may own several tokens (virtual nodes); preference
+ * 				lists always name NUM_REPLICAS distinct physical nodes.
+ */
+class RingIndex {
+public:
+	// version number, bumped by the owner every time membership changes
+	int version;
+	// nodes sorted by token
+	vector<Node> nodes;
+	// tokens[i] is the token of nodes[i]
+	vector<size_t> tokens;
+	// preferenceLists[i] are the replicas of range i
+	vector<vector<Node>> preferenceLists;
+	// number of distinct physical nodes on the ring
+	size_t physicalNodes;
+	RingIndex();
+	void build(const vector<Node> &sortedNodes, int version);
+	size_t size();
+	int rangeOf(size_t pos);
+	vector<Node> &findNodes(size_t pos);
+	double rangeShare(int range);
+	void loadShare(map<unsigned long long, double> &primaryShare, map<unsigned long long, double> &replicaShare);
+	virtual ~RingIndex();
+};
+
+#endif /* RINGINDEX_H_ */
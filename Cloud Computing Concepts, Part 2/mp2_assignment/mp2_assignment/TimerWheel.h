@@ -0,0 +1,87 @@
+/**********************************
+ * FILE NAME: TimerWheel.h
+ *
+ * DESCRIPTION: Header file of the hashed timing wheel used to expire
+ * 				coordinator transactions
+ **********************************/
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// slots in the wheel, a power of two; deadlines further out than this take
+// more than one turn of the wheel
+#define TIMERWHEEL_SLOTS 64
+
+/**
+ * CLASS NAME: TimerWheel
+ *
+ * DESCRIPTION: Hashed timing wheel of (deadline, id) timers, one slot per time
+ * 				unit modulo TIMERWHEEL_SLOTS. A tick only visits the slots of the
+ * 				time units that passed, so its cost follows the number of timers
+ * 				due rather than the number scheduled. Timers cannot be cancelled:
+ * 				the owner keeps the live ids and ignores expirations of ids it has
+ * 				already finished (lazy deletion).
+ */
+class TimerWheel {
+	struct Timer {
+		int deadline;
+		int id;
+	};
+	vector<Timer> slots[TIMERWHEEL_SLOTS];
+	// last time unit whose slot has been expired
+	int current;
+	size_t pending;
+
+public:
+	TimerWheel(): current(-1), pending(0) {}
+
+	size_t size() const { return pending; }
+
+	/**
+	 * FUNCTION NAME: schedule
+	 *
+	 * DESCRIPTION: Fire id once time reaches deadline
+	 */
+	void schedule(int id, int deadline) {
+		if ( deadline <= current ) {
+			deadline = current + 1;
+		}
+		slots[deadline & (TIMERWHEEL_SLOTS - 1)].push_back({deadline, id});
+		pending++;
+	}
+
+	/**
+	 * FUNCTION NAME: advance
+	 *
+	 * DESCRIPTION: Move the wheel to time now, appending the ids of all timers with
+	 * 				deadline <= now to expired
+	 */
+	void advance(int now, vector<int> &expired) {
+		if ( current < 0 || now - current > TIMERWHEEL_SLOTS ) {
+			// first tick, or the wheel has not turned for a full revolution
+			current = now - TIMERWHEEL_SLOTS;
+		}
+		while ( current < now ) {
+			current++;
+			vector<Timer> &slot = slots[current & (TIMERWHEEL_SLOTS - 1)];
+			size_t kept = 0;
+			for ( size_t i = 0; i < slot.size(); i++ ) {
+				if ( slot[i].deadline <= current ) {
+					expired.push_back(slot[i].id);
+					pending--;
+				}
+				else {
+					slot[kept++] = slot[i];
+				}
+			}
+			slot.resize(kept);
+		}
+	}
+};
+
+#endif /* TIMERWHEEL_H_ */
@@ -7,9 +7,26 @@
 // Transaction Id
 static int g_transID = 0;
 
-// message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
+// Uncomment to put the human readable "::" text format on the wire instead of
+// the binary format. Receivers decode both, so this only changes what is sent.
+// #define TEXT_WIRE_FORMAT
+
+// message types, reply is the message from node to coordinator;
+// the MULTI types carry a batch of keys for one replica,
+// MERKLEDIGEST the Merkle tree of one token range for anti-entropy,
+// STREAM the keys of ranges handed to a new replica on a ring change, and
+// HINT versioned writes pushed outside a client request: the writes a
+// coordinator held for a replica that was down, and read repairs;
+// READDIGEST asks a replica for a digest of its value instead of the value
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, MULTIGET, MULTIPUT, MULTIREPLY, MERKLEDIGEST, STREAM, STREAMACK, HINT, HINTACK, READDIGEST, DIGESTREPLY};
 // enum of replica types
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
+// how many replicas must acknowledge a client request before it completes
+enum ConsistencyLevel {ONE, QUORUM, ALL};
+#define CONSISTENCY_LEVELS 3
+// how clientRead asks the replicas: every replica returns the value, one
+// replica returns the value and the others a digest of it, or only a quorum
+// is asked and the other replicas are asked too once an answer is overdue
+enum ReadMode {READ_FULL, READ_DIGEST, READ_HEDGED};
 
 #endif
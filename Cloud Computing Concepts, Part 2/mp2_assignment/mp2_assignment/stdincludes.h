@@ -31,9 +31,14 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <queue>
+#include <functional>
 #include <fstream>
 
 using namespace std;